@@ -0,0 +1,300 @@
+#include "batchextractor.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <limits>
+#include "framepicker.h"
+#include "jobscheduler.h"
+#include "perceptualhash.h"
+#include "seekplanner.h"
+#include "sharpness.h"
+#include "stillness.h"
+#include "threadbudget.h"
+
+BatchExtractor::BatchExtractor(const Options &opts, DeviceLimiter *devices) :
+    opts(opts), devices(devices), failures(0), encodeNs(0), hashed(false), lastHash(0)
+{
+    this->opts.interval = qMax(opts.interval, 1);
+
+    // encoders are multi-threaded themselves, a few saves in flight suffice
+    if (this->opts.inFlight <= 0)
+        this->opts.inFlight = ThreadBudget::saves();
+
+#ifdef Q_OS_UNIX
+    if (!opts.stream.isEmpty()) {
+        auto sidecar = opts.sidecar;
+        if (opts.raw && sidecar.isEmpty() && opts.stream != "-")
+            sidecar = opts.stream + ".json";
+
+        stream.reset(new StreamWriter(opts.raw ? StreamWriter::Format::Raw : StreamWriter::Format::Y4M, sidecar));
+    }
+#endif
+}
+
+BatchExtractor::~BatchExtractor()
+{
+    settle(0);
+}
+
+bool BatchExtractor::run(const QString &fileName)
+{
+    QElapsedTimer total, clock;
+    total.start();
+    timed = Timing();
+    encodeNs = 0;
+
+    // reading holds a slot of the device until the last frame is decoded
+    clock.start();
+    std::unique_ptr<DeviceLimiter::Slot> slot;
+    if (devices)
+        slot.reset(new DeviceLimiter::Slot(*devices, fileName));
+    timed.waitMs = clock.nsecsElapsed() / 1e6;
+
+    FrameSource src;
+    SubtitleReader subs;
+
+    // motion comes with the decode when the codec exports vectors
+    const auto motion = opts.select == Selection::Stillest || opts.curve;
+    src.setExportMotionVectors(motion);
+    src.setThreads(opts.decoderThreads);
+
+    clock.restart();
+    try {
+        src.open(fileName, &pool);
+    }
+    catch (QString msg) {
+        qCritical() << fileName << msg;
+        timed.totalMs = total.nsecsElapsed() / 1e6;
+        return false;
+    }
+    timed.openMs = clock.nsecsElapsed() / 1e6;
+
+    subs.open(src.formatContext());
+    src.packetHook = [&subs](AVPacket *pkt) {
+        subs.feed(pkt);
+    };
+
+    const VideoProcessor::StreamInfo info {fileName, src.videoStream()->id, src.videoStream()->time_base,
+                                           src.rotation(), nullptr};
+#ifdef Q_OS_UNIX
+    if (stream)
+        stream->setSource(fileName, src.videoStream()->avg_frame_rate, src.videoStream()->time_base);
+#endif
+
+    const auto roi = opts.roi;
+    FramePicker picker([roi](const AVFrame *frm) {
+        return Sharpness::laplacianVariance(frm, roi);
+    });
+
+    Stillness meter;
+    std::vector<std::pair<int64_t, double>> curve;
+
+    hashed = false;
+    skipped.clear();
+
+    auto frm = av_frame_alloc();
+    const auto before = failures;
+    int64_t index = 0;
+    int stills = 0;
+
+    const auto pick = [&]() {
+        QString sub;
+        if (picker.take(frm, &sub) && save(frm, info, sub))
+            stills++;
+    };
+
+    clock.restart();
+    if (!opts.times.empty()) {
+        index = saveTimes(src, subs, info, stills);
+    }
+    else {
+        while (src.next(frm)) {
+            const auto amount = motion ? meter.measure(frm) : -1;
+            if (opts.curve)
+                curve.emplace_back(FrameSource::ptsOf(frm), amount);
+
+            if (opts.select == Selection::Sharpest || opts.select == Selection::Stillest) {
+                if (opts.select == Selection::Sharpest)
+                    picker.add(frm, subs.text());
+                else
+                    picker.add(frm, amount < 0 ? -std::numeric_limits<double>::infinity() : -amount, subs.text());
+
+                if (picker.count() == opts.interval)
+                    pick();
+            }
+            else if (index % opts.interval == 0 && save(frm, info, subs.text())) {
+                stills++;
+            }
+
+            index++;
+        }
+    }
+
+    // partial last interval
+    if (picker.count())
+        pick();
+
+    av_frame_free(&frm);
+    slot.reset();
+    settle(0);
+    timed.decodeMs = clock.nsecsElapsed() / 1e6;
+
+    const auto work = src.stats();
+    counters.add(Metrics::PacketsRead, work.packets);
+    counters.add(Metrics::FramesDecoded, work.decoded);
+    counters.add(Metrics::BytesRead, work.bytes);
+
+    if (opts.curve && !writeCurve(info, curve))
+        failures++;
+
+    qInfo() << fileName << ":" << stills << "stills from" << index << "frames";
+    if (!skipped.empty()) {
+        QStringList times;
+        for (const auto pts: skipped)
+            times << QString::number(av_rescale_q(pts, info.timeBase, AVRational{1, 1000}));
+        qInfo() << fileName << ":" << skipped.size() << "duplicates skipped at" << times.join(", ") << "ms";
+    }
+
+    timed.encodeMs = encodeNs / 1e6;
+    timed.totalMs = total.nsecsElapsed() / 1e6;
+    timed.frames = index;
+    timed.stills = stills;
+    timed.ok = failures == before;
+
+    return timed.ok;
+}
+
+int64_t BatchExtractor::saveTimes(FrameSource &src, const SubtitleReader &subs,
+                                  const VideoProcessor::StreamInfo &info, int &stills)
+{
+    const auto strm = src.videoStream();
+    const auto start = strm->start_time != AV_NOPTS_VALUE ? strm->start_time : 0;
+    std::vector<SeekPlanner::Request> requests;
+    for (size_t i = 0; i < opts.times.size(); i++) {
+        const auto offset = av_rescale_q(int64_t(opts.times[i] * AV_TIME_BASE), AV_TIME_BASE_Q, info.timeBase);
+        requests.push_back({int(i), start + offset});
+    }
+
+    // frames come in file order, times that land on the same frame save it once
+    int64_t prev = AV_NOPTS_VALUE;
+    SeekPlanner planner(src);
+    const auto delivered = planner.run(requests, [&](int, AVFrame *frm) {
+        if (FrameSource::ptsOf(frm) != prev && save(frm, info, subs.text()))
+            stills++;
+        prev = FrameSource::ptsOf(frm);
+    });
+    counters.add(Metrics::Seeks, planner.seeks());
+
+    qInfo() << info.fileName << ":" << delivered << "of" << requests.size() << "times found in" << planner.groups()
+            << "GOPs with" << planner.seeks() << "seeks";
+
+    return delivered;
+}
+
+bool BatchExtractor::isDuplicate(const AVFrame *frm)
+{
+    if (opts.dedupe < 0)
+        return false;
+
+    uint64_t hash;
+    if (!PerceptualHash::compute(frm, hash))
+        return false;
+
+    // compared with the last still written, so slow drifts still produce new ones
+    if (hashed && PerceptualHash::distance(hash, lastHash) <= opts.dedupe)
+        return true;
+
+    hashed = true;
+    lastHash = hash;
+    return false;
+}
+
+bool BatchExtractor::save(AVFrame *frm, const VideoProcessor::StreamInfo &info, const QString &sub)
+{
+    if (isDuplicate(frm)) {
+        skipped.push_back(FrameSource::ptsOf(frm));
+        return false;
+    }
+
+    counters.add(Metrics::SavesStarted);
+
+#ifdef Q_OS_UNIX
+    // in order on this thread, there is nothing to encode
+    if (stream) {
+        ExifData exif;
+        QString icc;
+        ColorParams color;
+        auto meta = std::async(std::launch::deferred, []() {});
+        QElapsedTimer clock;
+        clock.start();
+        const auto ok = stream->save(frm, opts.stream, meta, icc, color, exif);
+        encodeNs += clock.nsecsElapsed();
+
+        if (!ok) {
+            failures++;
+            counters.add(Metrics::SavesFailed);
+        }
+        return ok;
+    }
+#endif
+
+    // name after the source and the frame's time stamp
+    const auto ms = av_rescale_q(FrameSource::ptsOf(frm), info.timeBase, AVRational{1, 1000});
+    const auto name = QString("%1/%2-%3.heic").arg(opts.outDir, QFileInfo(info.fileName).completeBaseName())
+                          .arg(ms, 8, 10, QChar('0'));
+
+    std::shared_ptr<AVFrame> ref(av_frame_clone(frm), [](AVFrame *f) {
+        av_frame_free(&f);
+    });
+
+    settle(opts.inFlight - 1);
+
+    counters.add(Metrics::SavesInFlight);
+    const auto encode = [this, ref, info, name, sub]() {
+        QElapsedTimer clock;
+        clock.start();
+        const auto ok = VideoProcessor::writeFrame(ref.get(), info, name, sub);
+        encodeNs += clock.nsecsElapsed();
+        return ok;
+    };
+    saves.push_back(JobScheduler::shared().submit(encode));
+
+    return true;
+}
+
+bool BatchExtractor::writeCurve(const VideoProcessor::StreamInfo &info,
+                                const std::vector<std::pair<int64_t, double>> &curve)
+{
+    const auto name = QString("%1/%2-motion.csv").arg(opts.outDir, QFileInfo(info.fileName).completeBaseName());
+    QFile file(name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "cannot write" << name;
+        return false;
+    }
+
+    // time stamp in ms and motion, empty where unknown
+    file.write("time_ms,motion\n");
+    for (const auto &[pts, amount]: curve) {
+        const auto ms = av_rescale_q(pts, info.timeBase, AVRational{1, 1000});
+        file.write(QString("%1,%2\n").arg(ms).arg(amount < 0 ? QString() : QString::number(amount, 'f', 3))
+                       .toLatin1());
+    }
+
+    return true;
+}
+
+void BatchExtractor::settle(size_t keep)
+{
+    while (saves.size() > keep) {
+        if (!saves.front().get()) {
+            failures++;
+            counters.add(Metrics::SavesFailed);
+        }
+        counters.add(Metrics::SavesInFlight, -1);
+
+        saves.pop_front();
+    }
+}
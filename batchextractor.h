@@ -0,0 +1,95 @@
+#ifndef BATCHEXTRACTOR_H
+#define BATCHEXTRACTOR_H
+
+#include <atomic>
+#include <future>
+#include <list>
+#include <memory>
+#include <vector>
+#include <QRect>
+#include <QString>
+#include "devicelimiter.h"
+#include "framepool.h"
+#include "framesource.h"
+#include "metrics.h"
+#ifdef Q_OS_UNIX
+#include "streamwriter.h"
+#endif
+#include "subtitlereader.h"
+#include "videoprocessor.h"
+
+// extracts stills from whole videos without the UI, one per interval of frames
+class BatchExtractor
+{
+public:
+    enum class Selection {
+        First,
+        Sharpest,
+        Stillest
+    };
+
+    struct Options {
+        QString outDir;
+        int interval = 30;
+        Selection select = Selection::First;
+        QRect roi;
+        bool curve = false; // write the motion curve of each file as CSV
+        int dedupe = -1; // skip stills within this many hash bits of the last saved one, negative keeps all
+        QString stream; // one stream of all stills instead of HEIC files, "-" for standard output
+        bool raw = false; // raw planes described by a JSON sidecar instead of Y4M
+        QString sidecar;
+        int inFlight = 0; // saves queued per file, 0 for the saves the shared pool runs at once
+        int decoderThreads = 0; // 0 for ThreadBudget::decoder()
+        std::vector<double> times; // stills at these times in seconds instead of one per interval
+    };
+
+    // where the time of one file went
+    struct Timing {
+        double waitMs = 0;   // for a read slot of its device
+        double openMs = 0;
+        double decodeMs = 0; // demuxing, decoding and picking, including waits for queued saves
+        double encodeMs = 0; // summed over its saves
+        double totalMs = 0;
+        int64_t frames = 0;
+        int stills = 0;
+        bool ok = false;
+    };
+
+    // saves go to the shared pool, reads wait for devices when given
+    explicit BatchExtractor(const Options &opts, DeviceLimiter *devices = nullptr);
+    BatchExtractor(const BatchExtractor &) = delete;
+    ~BatchExtractor();
+
+    bool run(const QString &fileName);
+    // totals over all files run so far
+    const Metrics &metrics() const {return counters;}
+    // of the last file run
+    const Timing &timing() const {return timed;}
+
+protected:
+    Options opts;
+    DeviceLimiter *devices;
+    FramePool pool;
+#ifdef Q_OS_UNIX
+    std::unique_ptr<StreamWriter> stream;
+#endif
+    std::list<std::future<bool>> saves;
+    int failures;
+    Metrics counters;
+    Timing timed;
+    std::atomic<int64_t> encodeNs;
+
+    // duplicate suppression within the current file
+    bool hashed;
+    uint64_t lastHash;
+    std::vector<int64_t> skipped;
+
+    int64_t saveTimes(FrameSource &src, const SubtitleReader &subs, const VideoProcessor::StreamInfo &info,
+                      int &stills);
+    bool isDuplicate(const AVFrame *frm);
+    bool save(AVFrame *frm, const VideoProcessor::StreamInfo &info, const QString &sub);
+    bool writeCurve(const VideoProcessor::StreamInfo &info, const std::vector<std::pair<int64_t, double>> &curve);
+    void settle(size_t keep);
+};
+
+#endif // BATCHEXTRACTOR_H
@@ -0,0 +1,135 @@
+#include "batchrunner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "threadbudget.h"
+
+BatchRunner::BatchRunner(const BatchExtractor::Options &opts, const Limits &limits) :
+    opts(opts), limits(limits), devices(limits.perDevice), wallMs(0)
+{
+    // one stream takes the stills in file order
+    if (!opts.stream.isEmpty())
+        this->limits.jobs = 1;
+    this->limits.jobs = qMax(this->limits.jobs, 1);
+}
+
+bool BatchRunner::run(const QStringList &files)
+{
+    this->files = files;
+    timings.assign(files.size(), BatchExtractor::Timing());
+
+    QElapsedTimer clock;
+    clock.start();
+
+    std::atomic<int> next {0};
+    std::atomic<bool> ok {true};
+    std::vector<std::unique_ptr<BatchExtractor>> extractors;
+    std::vector<std::thread> threads;
+    const auto jobs = qMin(limits.jobs, qMax(int(files.size()), 1));
+
+    // files decoding at once: jobs beyond what the devices serve wait for a slot. Enough queued per file to keep
+    // the pool's saves busy while other files open, and the decoders' share of the budget split among the files
+    const auto decoding = qBound(1, devices.concurrency(files), jobs);
+    auto fileOpts = opts;
+    if (fileOpts.inFlight <= 0)
+        fileOpts.inFlight = qMax(2 * ThreadBudget::saves() / decoding, 1);
+    if (fileOpts.decoderThreads <= 0)
+        fileOpts.decoderThreads = qMax(ThreadBudget::decoder() / decoding, 1);
+
+    for (int j = 0; j < jobs; j++)
+        extractors.emplace_back(new BatchExtractor(fileOpts, &devices));
+
+    for (int j = 0; j < jobs; j++) {
+        threads.emplace_back([&, j]() {
+            auto &extractor = *extractors[j];
+            for (auto i = next++; i < int(files.size()); i = next++) {
+                if (!extractor.run(files[i]))
+                    ok = false;
+                timings[i] = extractor.timing();
+            }
+        });
+    }
+
+    for (auto &thread: threads)
+        thread.join();
+
+    wallMs = clock.nsecsElapsed() / 1e6;
+
+    for (const auto &extractor: extractors) {
+        for (int c = 0; c < Metrics::counterCount; c++)
+            counters.add(Metrics::Counter(c), extractor->metrics().value(Metrics::Counter(c)));
+    }
+
+    return ok;
+}
+
+void BatchRunner::report() const
+{
+    double busy = 0;
+    int failed = 0;
+    for (size_t i = 0; i < timings.size(); i++) {
+        const auto &t = timings[i];
+        qInfo().noquote() << QString("%1 %2 ms: wait %3, open %4, decode %5, encode %6, %7 stills from %8 frames%9")
+                                 .arg(QFileInfo(files[i]).fileName()).arg(t.totalMs, 0, 'f', 0)
+                                 .arg(t.waitMs, 0, 'f', 0).arg(t.openMs, 0, 'f', 0).arg(t.decodeMs, 0, 'f', 0)
+                                 .arg(t.encodeMs, 0, 'f', 0).arg(t.stills).arg(t.frames)
+                                 .arg(t.ok ? "" : ", failed");
+        busy += t.totalMs;
+        failed += t.ok ? 0 : 1;
+    }
+
+    // how much the files overlapped
+    qInfo().noquote() << QString("%1 files in %2 ms, %3 failed, %4x parallel").arg(timings.size())
+                             .arg(wallMs, 0, 'f', 0).arg(failed).arg(wallMs > 0 ? busy / wallMs : 0, 0, 'f', 1);
+}
+
+bool BatchRunner::writeReport(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "cannot write" << fileName;
+        return false;
+    }
+
+    file.write("file,wait_ms,open_ms,decode_ms,encode_ms,total_ms,frames,stills,ok\n");
+    for (size_t i = 0; i < timings.size(); i++) {
+        const auto &t = timings[i];
+        file.write(QString("\"%1\",%2,%3,%4,%5,%6,%7,%8,%9\n").arg(QString(files[i]).replace("\"", "\"\""))
+                       .arg(t.waitMs, 0, 'f', 1).arg(t.openMs, 0, 'f', 1).arg(t.decodeMs, 0, 'f', 1)
+                       .arg(t.encodeMs, 0, 'f', 1).arg(t.totalMs, 0, 'f', 1).arg(t.frames).arg(t.stills)
+                       .arg(t.ok ? 1 : 0).toUtf8());
+    }
+
+    return true;
+}
+
+QStringList BatchRunner::collect(const QStringList &paths)
+{
+    QStringList files;
+    for (const auto &path: paths) {
+        if (!QFileInfo(path).isDir()) {
+            files << path;
+            continue;
+        }
+
+        // same extensions as the open dialog, in any case
+        QStringList found;
+        QDirIterator it(path, {"*.mpg", "*.mpeg", "*.mov", "*.mp4", "*.3gp"}, QDir::Files,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext())
+            found << it.next();
+
+        std::sort(found.begin(), found.end());
+        files << found;
+    }
+
+    return files;
+}
@@ -0,0 +1,46 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include "batchextractor.h"
+#include "devicelimiter.h"
+#include "metrics.h"
+
+// extracts from many files at once: each decode thread takes whole files in turn, keeping a file's decode on
+// one thread, while the saves of all files share the process-wide pool
+class BatchRunner
+{
+public:
+    struct Limits {
+        int jobs = 1;      // files decoded at once
+        int perDevice = 2; // files read at once from one storage device
+    };
+
+    BatchRunner(const BatchExtractor::Options &opts, const Limits &limits);
+    BatchRunner(const BatchRunner &) = delete;
+
+    bool run(const QStringList &files);
+
+    // totals over all files run
+    const Metrics &metrics() const {return counters;}
+    // per file timings of the last run, logged and optionally written as CSV
+    void report() const;
+    bool writeReport(const QString &fileName) const;
+
+    // the files given and the videos below the directories given, in name order per directory
+    static QStringList collect(const QStringList &paths);
+
+protected:
+    BatchExtractor::Options opts;
+    Limits limits;
+    DeviceLimiter devices;
+    Metrics counters;
+
+    QStringList files;
+    std::vector<BatchExtractor::Timing> timings;
+    double wallMs;
+};
+
+#endif // BATCHRUNNER_H
@@ -0,0 +1,53 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+Benchmark::Benchmark(int iterations) : iterations(std::max(iterations, 1))
+{
+}
+
+void Benchmark::run(const std::string &name, const std::function<void()> &fn, double bytes, int iterations)
+{
+    if (iterations <= 0)
+        iterations = this->iterations;
+
+    // warm caches and lazily initialized state
+    fn();
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto pct = [&](double p) {
+        return samples[std::min(samples.size() - 1, size_t(p * samples.size()))];
+    };
+
+    results.push_back({name, iterations, pct(0.5), pct(0.9), pct(0.99), samples.back(), bytes});
+    fprintf(stderr, "%-48s p50 %12.0f ns\n", name.c_str(), results.back().p50);
+}
+
+std::string Benchmark::json() const
+{
+    std::string out = "[\n";
+    char buf[512];
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &res = results[i];
+        snprintf(buf, sizeof(buf),
+                 "  {\"name\": \"%s\", \"iterations\": %d, \"p50_ns\": %.0f, \"p90_ns\": %.0f, "
+                 "\"p99_ns\": %.0f, \"max_ns\": %.0f, \"gb_per_s\": %.3f, \"per_s\": %.1f}%s\n",
+                 res.name.c_str(), res.iterations, res.p50, res.p90, res.p99, res.max,
+                 res.bytes / res.p50, 1e9 / res.p50, i + 1 < results.size() ? "," : "");
+        out += buf;
+    }
+
+    return out + "]\n";
+}
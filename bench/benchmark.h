@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// runs timed cases and reports latency percentiles as JSON
+class Benchmark
+{
+public:
+    explicit Benchmark(int iterations);
+
+    // iterations overrides the default for slow cases, 0 keeps it
+    void run(const std::string &name, const std::function<void()> &fn, double bytes = 0, int iterations = 0);
+    std::string json() const;
+
+protected:
+    struct Result {
+        std::string name;
+        int iterations;
+        double p50, p90, p99, max; // nanoseconds
+        double bytes;              // processed per iteration
+    };
+
+    int iterations;
+    std::vector<Result> results;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,297 @@
+#include "clipgenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+ClipGenerator::ClipGenerator(int width, int height, int frames) : width(width), height(height), frames(frames)
+{
+}
+
+std::vector<ClipGenerator::Clip> ClipGenerator::standardClips()
+{
+    return {
+        {"h264-8bit-gop12", "libx264", AV_PIX_FMT_YUV420P, 12, false},
+        {"h264-8bit-gop120", "libx264", AV_PIX_FMT_YUV420P, 120, false},
+        {"h264-8bit-gop30-gpmf", "libx264", AV_PIX_FMT_YUV420P, 30, true},
+        {"h264-10bit-gop30", "libx264", AV_PIX_FMT_YUV420P10LE, 30, false},
+        {"hevc-8bit-gop30", "libx265", AV_PIX_FMT_YUV420P, 30, false},
+        {"hevc-10bit-gop60-gpmf", "libx265", AV_PIX_FMT_YUV420P10LE, 60, true},
+    };
+}
+
+std::string ClipGenerator::generate(const Clip &clip, const std::string &dir)
+{
+    const auto path = dir + "/" + clip.name + "-" + std::to_string(width) + "x" + std::to_string(height) + "-" +
+                      std::to_string(frames) + ".mov";
+
+    if (auto file = fopen(path.c_str(), "rb")) {
+        fclose(file);
+        return path;
+    }
+
+    // written under a temporary name so an interrupted run is not mistaken for a clip
+    const auto part = path + ".part";
+    if (!encode(clip, part)) {
+        remove(part.c_str());
+        return std::string();
+    }
+
+    if (rename(part.c_str(), path.c_str()))
+        return std::string();
+
+    return path;
+}
+
+// moving texture with a little noise, so the encoder has actual work to do
+template<typename T>
+static void fillFrame(AVFrame *frm, int index, int shift)
+{
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(frm->format));
+
+    for (int p = 0; p < 3; p++) {
+        const auto w = p ? AV_CEIL_RSHIFT(frm->width, desc->log2_chroma_w) : frm->width;
+        const auto h = p ? AV_CEIL_RSHIFT(frm->height, desc->log2_chroma_h) : frm->height;
+
+        for (int y = 0; y < h; y++) {
+            auto row = reinterpret_cast<T *>(frm->data[p] + ptrdiff_t(frm->linesize[p]) * y);
+            for (int x = 0; x < w; x++) {
+                const auto noise = (uint32_t(x) * 73856093u ^ uint32_t(y) * 19349663u ^ uint32_t(index) * 83492791u)
+                                   >> 28;
+                int val;
+                if (p == 0)
+                    val = ((x + 2 * index) ^ (y + index)) & 255;
+                else
+                    val = 128 + (((p == 1 ? x : y) + index) & 63) - 32;
+
+                row[x] = T((std::clamp(val + int(noise) - 8, 0, 255) << shift) | (noise & ((1 << shift) - 1)));
+            }
+        }
+    }
+}
+
+bool ClipGenerator::encode(const Clip &clip, const std::string &path)
+{
+    const auto codec = avcodec_find_encoder_by_name(clip.encoder.c_str());
+    if (!codec) {
+        fprintf(stderr, "%s: encoder %s not available\n", clip.name.c_str(), clip.encoder.c_str());
+        return false;
+    }
+
+    AVFormatContext *oc = nullptr;
+    if (avformat_alloc_output_context2(&oc, nullptr, "mov", path.c_str()) < 0)
+        return false;
+    std::unique_ptr<AVFormatContext, void (*)(AVFormatContext *)> fmtCtx(oc, [](AVFormatContext *ctx) {
+        if (ctx->pb)
+            avio_closep(&ctx->pb);
+        avformat_free_context(ctx);
+    });
+
+    std::unique_ptr<AVCodecContext, void (*)(AVCodecContext *)> enc(avcodec_alloc_context3(codec),
+                                                                    [](AVCodecContext *ctx) {
+        avcodec_free_context(&ctx);
+    });
+
+    const auto ctx = enc.get();
+    ctx->width = width;
+    ctx->height = height;
+    ctx->pix_fmt = AVPixelFormat(clip.pixFmt);
+    ctx->time_base = AVRational{1, frameRate};
+    ctx->framerate = AVRational{frameRate, 1};
+    ctx->gop_size = clip.gop;
+    ctx->keyint_min = clip.gop;
+    ctx->max_b_frames = 2;
+    ctx->color_primaries = AVCOL_PRI_BT709;
+    ctx->color_trc = AVCOL_TRC_BT709;
+    ctx->colorspace = AVCOL_SPC_BT709;
+    ctx->color_range = AVCOL_RANGE_MPEG;
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    // fixed GOPs without scene cut keyframes, the content is synthetic anyway
+    AVDictionary *opts = nullptr;
+    av_dict_set(&opts, "preset", "ultrafast", 0);
+    if (clip.encoder == "libx265")
+        av_dict_set(&opts, "x265-params", "log-level=error:scenecut=0", 0);
+    else
+        av_dict_set(&opts, "sc_threshold", "0", 0);
+
+    const auto ret = avcodec_open2(ctx, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "%s: %s cannot encode %s\n", clip.name.c_str(), clip.encoder.c_str(),
+                av_get_pix_fmt_name(ctx->pix_fmt));
+        return false;
+    }
+
+    const auto video = avformat_new_stream(oc, nullptr);
+    avcodec_parameters_from_context(video->codecpar, ctx);
+    video->time_base = ctx->time_base;
+    if (codec->id == AV_CODEC_ID_HEVC)
+        video->codecpar->codec_tag = MKTAG('h', 'v', 'c', '1');
+
+    // same handler name as the cameras write, MediaReader looks for it
+    AVStream *meta = nullptr;
+    if (clip.gopro) {
+        meta = avformat_new_stream(oc, nullptr);
+        meta->codecpar->codec_type = AVMEDIA_TYPE_DATA;
+        meta->codecpar->codec_id = AV_CODEC_ID_BIN_DATA;
+        meta->codecpar->codec_tag = MKTAG('g', 'p', 'm', 'd');
+        meta->time_base = AVRational{1, 1000};
+        av_dict_set(&meta->metadata, "handler_name", "GoPro MET  ", 0);
+    }
+
+    if (avio_open(&oc->pb, path.c_str(), AVIO_FLAG_WRITE) < 0 || avformat_write_header(oc, nullptr) < 0) {
+        fprintf(stderr, "%s: cannot write %s\n", clip.name.c_str(), path.c_str());
+        return false;
+    }
+
+    std::unique_ptr<AVFrame, void (*)(AVFrame *)> frm(av_frame_alloc(), [](AVFrame *f) {
+        av_frame_free(&f);
+    });
+    std::unique_ptr<AVPacket, void (*)(AVPacket *)> pkt(av_packet_alloc(), [](AVPacket *p) {
+        av_packet_free(&p);
+    });
+
+    frm->format = ctx->pix_fmt;
+    frm->width = width;
+    frm->height = height;
+    if (av_frame_get_buffer(frm.get(), 0) < 0)
+        return false;
+
+    const auto drain = [&]() {
+        int err;
+        while ((err = avcodec_receive_packet(ctx, pkt.get())) >= 0) {
+            av_packet_rescale_ts(pkt.get(), ctx->time_base, video->time_base);
+            pkt->stream_index = video->index;
+            if (av_interleaved_write_frame(oc, pkt.get()) < 0)
+                return false;
+        }
+
+        return err == AVERROR(EAGAIN) || err == AVERROR_EOF;
+    };
+
+    const auto shift = av_pix_fmt_desc_get(ctx->pix_fmt)->comp[0].depth - 8;
+    for (int i = 0; i < frames; i++) {
+        if (av_frame_make_writable(frm.get()) < 0)
+            return false;
+
+        if (shift)
+            fillFrame<uint16_t>(frm.get(), i, shift);
+        else
+            fillFrame<uint8_t>(frm.get(), i, 0);
+
+        frm->pts = i;
+        if (avcodec_send_frame(ctx, frm.get()) < 0 || !drain())
+            return false;
+
+        if (meta && i % frameRate == 0) {
+            auto sample = gpmfSample(i / frameRate);
+            std::unique_ptr<AVPacket, void (*)(AVPacket *)> data(av_packet_alloc(), [](AVPacket *p) {
+                av_packet_free(&p);
+            });
+            if (av_new_packet(data.get(), int(sample.size())) < 0)
+                return false;
+
+            memcpy(data->data, sample.data(), sample.size());
+            data->pts = data->dts = int64_t(i / frameRate) * 1000;
+            data->duration = 1000;
+            data->stream_index = meta->index;
+            data->flags |= AV_PKT_FLAG_KEY;
+            if (av_interleaved_write_frame(oc, data.get()) < 0)
+                return false;
+        }
+    }
+
+    if (avcodec_send_frame(ctx, nullptr) < 0 || !drain())
+        return false;
+
+    return av_write_trailer(oc) >= 0;
+}
+
+static void put16(std::vector<uint8_t> &out, uint16_t val)
+{
+    out.push_back(uint8_t(val >> 8));
+    out.push_back(uint8_t(val));
+}
+
+static void put32(std::vector<uint8_t> &out, uint32_t val)
+{
+    put16(out, uint16_t(val >> 16));
+    put16(out, uint16_t(val));
+}
+
+// key, type, structure size, repeat, then the big endian payload padded to 32 bits; type 0 nests
+static void klv(std::vector<uint8_t> &out, const char *key, char type, int structSize, int repeat,
+                const std::vector<uint8_t> &payload)
+{
+    out.insert(out.end(), key, key + 4);
+    out.push_back(uint8_t(type));
+    out.push_back(uint8_t(structSize));
+    put16(out, uint16_t(repeat));
+    out.insert(out.end(), payload.begin(), payload.end());
+    out.resize((out.size() + 3) & ~size_t(3), 0);
+}
+
+static void klvString(std::vector<uint8_t> &out, const char *key, const std::string &str)
+{
+    klv(out, key, 'c', 1, int(str.size()), std::vector<uint8_t>(str.begin(), str.end()));
+}
+
+static void klvNested(std::vector<uint8_t> &out, const char *key, const std::vector<uint8_t> &inner)
+{
+    klv(out, key, 0, 1, int(inner.size()), inner);
+}
+
+std::vector<uint8_t> ClipGenerator::gpmfSample(int second)
+{
+    // 18 Hz GPS like the HERO cameras, slowly walking north east
+    constexpr int gpsRate = 18;
+    const int32_t scale[5] = {10000000, 10000000, 1000, 1000, 100};
+
+    std::vector<uint8_t> scal, fix, time, dop, gps;
+    for (const auto s: scale)
+        put32(scal, uint32_t(s));
+    put32(fix, 3);
+    put16(dop, 250);
+
+    char stamp[20];
+    snprintf(stamp, sizeof(stamp), "26101812%02d%02d.000", second / 60 % 60, second % 60);
+    time.assign(stamp, stamp + 16);
+
+    for (int i = 0; i < gpsRate; i++) {
+        const auto t = second + double(i) / gpsRate;
+        put32(gps, uint32_t(int32_t(std::lround((48.137154 + t * 1e-5) * scale[0]))));
+        put32(gps, uint32_t(int32_t(std::lround((11.576124 + t * 1e-5) * scale[1]))));
+        put32(gps, uint32_t(int32_t(std::lround((519.0 + std::sin(t)) * scale[2]))));
+        put32(gps, uint32_t(int32_t(1.4 * scale[3])));
+        put32(gps, uint32_t(int32_t(1.4 * scale[4])));
+    }
+
+    std::vector<uint8_t> strm;
+    klvString(strm, "STNM", "GPS (Lat., Long., Alt., 2D speed, 3D speed)");
+    klv(strm, "SCAL", 'l', 4, 5, scal);
+    klv(strm, "GPSF", 'L', 4, 1, fix);
+    klv(strm, "GPSU", 'U', 16, 1, time);
+    klv(strm, "GPSP", 'S', 2, 1, dop);
+    klv(strm, "GPS5", 'l', 20, gpsRate, gps);
+
+    std::vector<uint8_t> devc, id;
+    put32(id, 1);
+    klv(devc, "DVID", 'L', 4, 1, id);
+    klvString(devc, "DVNM", "Synthetic HERO");
+    klvNested(devc, "STRM", strm);
+
+    std::vector<uint8_t> sample;
+    klvNested(sample, "DEVC", devc);
+    return sample;
+}
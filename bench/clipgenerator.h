@@ -0,0 +1,37 @@
+#ifndef CLIPGENERATOR_H
+#define CLIPGENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// encodes synthetic MOV clips with libavcodec so benchmarks need no sample media
+class ClipGenerator
+{
+public:
+    struct Clip {
+        std::string name;
+        std::string encoder; // libavcodec encoder name
+        int pixFmt;          // AVPixelFormat
+        int gop;
+        bool gopro;          // GoPro-style GPMF metadata track, one sample per second
+    };
+
+    ClipGenerator(int width, int height, int frames);
+
+    // a mix of codecs, bit depths, GOP lengths and metadata tracks
+    static std::vector<Clip> standardClips();
+
+    // writes the clip to dir unless it is there already, returns the path or an empty string
+    std::string generate(const Clip &clip, const std::string &dir);
+
+protected:
+    static constexpr int frameRate = 30;
+
+    int width, height, frames;
+
+    bool encode(const Clip &clip, const std::string &path);
+    static std::vector<uint8_t> gpmfSample(int second);
+};
+
+#endif // CLIPGENERATOR_H
@@ -0,0 +1,79 @@
+#include "benchmark.h"
+#include "clipgenerator.h"
+
+#include <QApplication>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QString>
+#include <cstdio>
+#include "frameview.h"
+#include "videoprocessor.h"
+
+// size of the window the frames are shown in
+static constexpr int viewWidth = 1920, viewHeight = 1080;
+
+// steps through the clip, starting over should it run out, until the frame is on screen
+static void stepAndShow(VideoProcessor &proc, int64_t &pos)
+{
+    const auto next = proc.presentPrevNext(false);
+    if (next == pos)
+        proc.present(0);
+    pos = next;
+
+    QApplication::processEvents();
+}
+
+// frames shown per second while stepping: painted by the frame view, and by a graphics scene rebuilt per frame
+void benchDisplay(Benchmark &bench, const std::string &clipDir, int width, int height, int frames)
+{
+    // the display side does not depend on the codec
+    ClipGenerator gen(width, height, frames);
+    const auto clip = ClipGenerator::standardClips().front();
+    const auto path = gen.generate(clip, clipDir);
+    if (path.empty()) {
+        fprintf(stderr, "%s: skipped\n", clip.name.c_str());
+        return;
+    }
+
+    VideoProcessor proc;
+    int64_t length = 0;
+    QObject::connect(&proc, &VideoProcessor::streamLength, [&](int64_t len) {
+        length = len;
+    });
+
+    proc.setDimensions(viewWidth, viewHeight);
+    proc.loadVideo(QString::fromStdString(path));
+    if (length <= 0) {
+        fprintf(stderr, "%s: cannot load %s\n", clip.name.c_str(), path.c_str());
+        return;
+    }
+
+    FrameView view;
+    view.resize(viewWidth, viewHeight);
+    view.show();
+
+    int64_t pos = -1;
+    auto shown = QObject::connect(&proc, &VideoProcessor::imgReady, &view, &FrameView::setImage);
+    proc.present(0);
+    bench.run("display/" + clip.name, [&] {stepAndShow(proc, pos);});
+    fprintf(stderr, "%-48s %12.1f fps painted\n", ("display/" + clip.name).c_str(), view.framesPerSecond());
+    QObject::disconnect(shown);
+    view.hide();
+
+    // how frames were shown before the frame view
+    QGraphicsView graphicsView;
+    graphicsView.resize(viewWidth, viewHeight);
+    graphicsView.show();
+    QGraphicsScene scene(graphicsView.viewport()->rect());
+    graphicsView.setScene(&scene);
+
+    pos = -1;
+    shown = QObject::connect(&proc, &VideoProcessor::imgReady, [&scene](QImage img) {
+        scene.clear();
+        scene.addPixmap(QPixmap::fromImage(img));
+    });
+    proc.present(0);
+    bench.run("display-scene/" + clip.name, [&] {stepAndShow(proc, pos);});
+    QObject::disconnect(shown);
+}
@@ -0,0 +1,68 @@
+#include "benchmark.h"
+#include "pixelkernels.h"
+
+#include <cstdlib>
+#include <memory>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+}
+
+// every pixel format specialization, native copy into padded planes and widening into dense ones
+void benchKernels(Benchmark &bench, int width, int height)
+{
+    int count;
+    const auto table = pixelKernelTable(count);
+
+    for (int k = 0; k < count; k++) {
+        const auto &kern = table[k];
+
+        std::unique_ptr<AVFrame, void (*)(AVFrame *)> frm(av_frame_alloc(), [](AVFrame *f) {
+            av_frame_free(&f);
+        });
+        frm->format = kern.format;
+        frm->width = width;
+        frm->height = height;
+        if (av_frame_get_buffer(frm.get(), 0) < 0)
+            continue;
+
+        // noise within the format's range, msb-aligned formats are masked by the shift anyway
+        for (int p = 0; p < AV_NUM_DATA_POINTERS && frm->buf[p]; p++)
+            for (size_t i = 0; i < frm->buf[p]->size; i++)
+                frm->buf[p]->data[i] = uint8_t(rand());
+        if (kern.depth > 8) {
+            const auto mask = uint16_t((1 << kern.depth) - 1);
+            const auto desc = av_pix_fmt_desc_get(kern.format);
+            for (int p = 0; p < AV_NUM_DATA_POINTERS && frm->buf[p]; p++) {
+                auto s = reinterpret_cast<uint16_t *>(frm->buf[p]->data);
+                for (size_t i = 0; i < frm->buf[p]->size / 2; i++)
+                    s[i] = uint16_t((s[i] & mask) << desc->comp[0].shift);
+            }
+        }
+
+        double bytes = 0;
+        PlaneTarget padded[3], dense[3];
+        std::unique_ptr<uint8_t, void (*)(void *)> mem[6] = {
+            {nullptr, av_free}, {nullptr, av_free}, {nullptr, av_free},
+            {nullptr, av_free}, {nullptr, av_free}, {nullptr, av_free}
+        };
+        for (int i = 0; i < 3; i++) {
+            const auto w = kern.planeWidth(i, width), h = kern.planeHeight(i, height);
+            bytes += double(w) * h * kern.bytesPerSample();
+
+            padded[i].stride = (w * kern.bytesPerSample() + 63) & ~63;
+            mem[i].reset(static_cast<uint8_t *>(av_malloc(padded[i].stride * h)));
+            padded[i].data = mem[i].get();
+
+            dense[i].stride = w * sizeof(int32_t);
+            mem[3 + i].reset(static_cast<uint8_t *>(av_malloc(dense[i].stride * h)));
+            dense[i].data = mem[3 + i].get();
+        }
+
+        const std::string name = av_get_pix_fmt_name(kern.format);
+        bench.run("kernel/copy/" + name, [&] {kern.copy(frm.get(), padded);}, bytes);
+        bench.run("kernel/widen/" + name, [&] {kern.widen(frm.get(), dense);}, bytes);
+    }
+}
@@ -0,0 +1,74 @@
+#include <QApplication>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "benchmark.h"
+
+void benchKernels(Benchmark &bench, int width, int height);
+void benchMedia(Benchmark &bench, const std::string &clipDir, int width, int height, int frames);
+void benchDisplay(Benchmark &bench, const std::string &clipDir, int width, int height, int frames);
+
+// keep the per-frame chatter of the processing code off the results
+static void quietHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg)
+        fprintf(stderr, "%s\n", msg.toLocal8Bit().constData());
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 50;
+    int width = 3840, height = 2160;
+    int clipWidth = 1920, clipHeight = 1080, clipFrames = 300;
+    std::string filter;
+    auto clipDir = (std::filesystem::temp_directory_path() / "visie-bench").string();
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (!strcmp(argv[i], "--clip-size") && i + 1 < argc)
+            sscanf(argv[++i], "%dx%d", &clipWidth, &clipHeight);
+        else if (!strcmp(argv[i], "--clip-frames") && i + 1 < argc)
+            clipFrames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--clips") && i + 1 < argc)
+            clipDir = argv[++i];
+        else if (!strcmp(argv[i], "--only") && i + 1 < argc)
+            filter = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [--iterations N] [--size WxH] [--clip-size WxH] [--clip-frames N] "
+                            "[--clips dir] [--only kernels|media|display]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // the processing code expects an application object, the display cases a window without needing a screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    int qtArgc = 1;
+    QApplication app(qtArgc, argv);
+    qInstallMessageHandler(quietHandler);
+
+    Benchmark bench(iterations);
+
+    if (filter.empty() || filter == "kernels")
+        benchKernels(bench, width, height);
+
+    if (filter.empty() || filter == "media" || filter == "display") {
+        std::error_code err;
+        std::filesystem::create_directories(clipDir, err);
+    }
+
+    if (filter.empty() || filter == "media")
+        benchMedia(bench, clipDir, clipWidth, clipHeight, clipFrames);
+
+    if (filter.empty() || filter == "display")
+        benchDisplay(bench, clipDir, clipWidth, clipHeight, clipFrames);
+
+    fputs(bench.json().c_str(), stdout);
+    return 0;
+}
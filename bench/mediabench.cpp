@@ -0,0 +1,179 @@
+#include "benchmark.h"
+#include "clipgenerator.h"
+
+#include <QString>
+#include <cstdio>
+#include <random>
+#include "videoprocessor.h"
+#include "framesource.h"
+#include "heifwriter.h"
+#include "mediareader.h"
+#include "seekplanner.h"
+
+// the protected steps of the UI path, driven without a window
+class BenchProcessor : public VideoProcessor
+{
+public:
+    using VideoProcessor::processCurrentFrame;
+
+    AVFrame *currentFrame() const {return curFrm->frm;}
+    int trackID() const {return src.videoStream()->id;}
+    AVRational timeBase() const {return src.videoStream()->time_base;}
+};
+
+// heavy cases run fewer times than the default
+static constexpr int encodeIterations = 10;
+// frames fetched at once by the batch cases
+static constexpr int batchRequests = 32;
+
+static void benchClip(Benchmark &bench, const std::string &name, const std::string &path,
+                      const std::string &outDir)
+{
+    BenchProcessor proc;
+    int64_t length = 0;
+    bool loaded = false;
+    QObject::connect(&proc, &VideoProcessor::streamLength, [&](int64_t len) {
+        length = len;
+    });
+    QObject::connect(&proc, &VideoProcessor::loadSuccess, [&]() {
+        loaded = true;
+    });
+
+    proc.setDimensions(1920, 1080);
+    proc.loadVideo(QString::fromStdString(path));
+    if (!loaded || length <= 0) {
+        fprintf(stderr, "%s: cannot load %s\n", name.c_str(), path.c_str());
+        return;
+    }
+
+    // same sequence of positions for every build
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int64_t> anywhere(0, length - 1);
+
+    bench.run("seek/" + name, [&] {proc.present(anywhere(rng));});
+
+    // stepping, starting over should the clip run out
+    int64_t pos = -1;
+    proc.present(0);
+    bench.run("step/" + name, [&] {
+        const auto next = proc.presentPrevNext(false);
+        if (next == pos)
+            proc.present(0);
+        pos = next;
+    });
+
+    pos = -1;
+    proc.present(length - 1);
+    bench.run("step-back/" + name, [&] {
+        const auto prev = proc.presentPrevNext(true);
+        if (prev == pos)
+            proc.present(length - 1);
+        pos = prev;
+    });
+
+    // time to first frame, trusting the MP4/MOV header and probing the streams
+    for (const auto fast: {true, false}) {
+        auto first = av_frame_alloc();
+        bench.run((fast ? "open/" : "open-probed/") + name, [&] {
+            FrameSource opened;
+            opened.setFastOpen(fast);
+            try {
+                opened.open(QString::fromStdString(path));
+                opened.seek(0, first);
+            }
+            catch (QString) {
+            }
+        }, 0, encodeIterations);
+        av_frame_free(&first);
+    }
+
+    // many frames at once: seeking to each in request order, and planned by GOP
+    FrameSource batchSrc;
+    try {
+        batchSrc.open(QString::fromStdString(path));
+    }
+    catch (QString msg) {
+        fprintf(stderr, "%s: %s\n", name.c_str(), msg.toLocal8Bit().constData());
+        return;
+    }
+
+    const auto strm = batchSrc.videoStream();
+    const auto start = strm->start_time != AV_NOPTS_VALUE ? strm->start_time : 0;
+    std::uniform_int_distribution<int64_t> within(0, length * batchSrc.frameDuration() - 1);
+    std::vector<SeekPlanner::Request> batch;
+    for (int i = 0; i < batchRequests; i++)
+        batch.push_back({i, start + within(rng)});
+
+    auto fetched = av_frame_alloc();
+    bench.run("seek-batch/" + name, [&] {
+        for (const auto &req: batch)
+            batchSrc.seek(req.pts, fetched);
+    }, 0, encodeIterations);
+    av_frame_free(&fetched);
+
+    bench.run("plan/" + name, [&] {
+        SeekPlanner planner(batchSrc);
+        planner.run(batch, [](int, AVFrame *) {});
+    }, 0, encodeIterations);
+    batchSrc.close();
+
+    proc.present(length / 2);
+    const auto frm = proc.currentFrame();
+    bench.run("convert/" + name, [&] {proc.processCurrentFrame();});
+
+    const auto heif = QString::fromStdString(outDir + "/" + name + ".heic");
+    bench.run("heif/" + name, [&] {
+        HeifWriter wr;
+        ExifData exif;
+        QString icc;
+        ColorParams colr = {1, 1, 1};
+        auto meta = std::async(std::launch::deferred, []() {});
+        wr.save(frm, heif, meta, icc, colr, exif);
+    }, 0, encodeIterations);
+    remove(heif.toLocal8Bit().constData());
+
+    // metadata at random positions, through an own I/O context like saves do
+    const auto timeBase = proc.timeBase();
+    const auto trackID = proc.trackID();
+    bench.run("mediareader/" + name, [&] {
+        AVIOContext *pb = nullptr;
+        if (avio_open(&pb, path.c_str(), AVIO_FLAG_READ) < 0)
+            return;
+
+        ExifData exif;
+        MediaReader rd(pb, &exif, trackID, av_q2d(timeBase) * anywhere(rng));
+        rd.extract();
+        avio_closep(&pb);
+    });
+
+    ExifData exif;
+    AVIOContext *pb = nullptr;
+    if (avio_open(&pb, path.c_str(), AVIO_FLAG_READ) >= 0) {
+        MediaReader rd(pb, &exif, trackID, av_q2d(timeBase) * (length / 2));
+        rd.extract();
+        avio_closep(&pb);
+    }
+    exif.add("Exif.Image.Software", "visie-bench");
+
+    std::vector<uint8_t> buf;
+    bench.run("exif/" + name, [&] {
+        buf.clear();
+        ExifSerializer::serialize(exif, buf);
+    });
+}
+
+// seeking, stepping, display conversion, HEIF encoding and metadata on synthetic clips
+void benchMedia(Benchmark &bench, const std::string &clipDir, int width, int height, int frames)
+{
+    ClipGenerator gen(width, height, frames);
+
+    for (const auto &clip: ClipGenerator::standardClips()) {
+        const auto path = gen.generate(clip, clipDir);
+        if (path.empty()) {
+            fprintf(stderr, "%s: skipped\n", clip.name.c_str());
+            continue;
+        }
+
+        benchClip(bench, clip.name, path, clipDir);
+    }
+}
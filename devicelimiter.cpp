@@ -0,0 +1,45 @@
+#include "devicelimiter.h"
+
+#include <set>
+#include <sys/stat.h>
+
+DeviceLimiter::DeviceLimiter(int perDevice) : perDevice(qMax(perDevice, 1))
+{
+}
+
+int DeviceLimiter::concurrency(const QStringList &files) const
+{
+    std::set<dev_t> devs;
+    for (const auto &fileName: files)
+        devs.insert(deviceOf(fileName));
+
+    return qMin(int(files.size()), perDevice * int(devs.size()));
+}
+
+dev_t DeviceLimiter::deviceOf(const QString &fileName)
+{
+    struct stat st;
+    if (stat(fileName.toLocal8Bit().constData(), &st) == 0)
+        return st.st_dev;
+
+    return 0;
+}
+
+DeviceLimiter::Slot::Slot(DeviceLimiter &limiter, const QString &fileName) :
+    limiter(limiter), dev(deviceOf(fileName))
+{
+    std::unique_lock<std::mutex> lock(limiter.mtx);
+    limiter.cond.wait(lock, [this]() {
+        return this->limiter.active[dev] < this->limiter.perDevice;
+    });
+    limiter.active[dev]++;
+}
+
+DeviceLimiter::Slot::~Slot()
+{
+    {
+        std::lock_guard<std::mutex> lock(limiter.mtx);
+        limiter.active[dev]--;
+    }
+    limiter.cond.notify_all();
+}
@@ -0,0 +1,45 @@
+#ifndef DEVICELIMITER_H
+#define DEVICELIMITER_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <QString>
+#include <QStringList>
+#include <sys/types.h>
+
+// caps the files read at once from each storage device, so spinning disks and network mounts are not
+// thrashed by parallel streams
+class DeviceLimiter
+{
+public:
+    explicit DeviceLimiter(int perDevice);
+    DeviceLimiter(const DeviceLimiter &) = delete;
+
+    // how many of the files can be read at once, given their devices
+    int concurrency(const QStringList &files) const;
+
+    // holds one read of the device a file lives on for its lifetime, waiting for it if needed
+    class Slot
+    {
+    public:
+        Slot(DeviceLimiter &limiter, const QString &fileName);
+        Slot(const Slot &) = delete;
+        ~Slot();
+
+    protected:
+        DeviceLimiter &limiter;
+        dev_t dev;
+    };
+
+protected:
+    int perDevice;
+
+    // files that cannot be looked at share one device, opening them fails soon enough
+    static dev_t deviceOf(const QString &fileName);
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::map<dev_t, int> active;
+};
+
+#endif // DEVICELIMITER_H
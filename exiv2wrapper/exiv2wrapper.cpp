@@ -61,6 +61,14 @@ void ExifData::add(const std::string &key, float val)
     (*d_ptr->data)[key] = Exiv2::floatToRationalCast(val);
 }
 
+void ExifData::merge(const ExifData &other)
+{
+    for (const auto &datum: *other.d_ptr->data) {
+        if (d_ptr->data->findKey(Exiv2::ExifKey(datum.key())) == d_ptr->data->end())
+            d_ptr->data->add(datum);
+    }
+}
+
 ExifImage::ExifImage(const std::string &path) : d_ptr(new ExifImageImpl(path))
 {
 }
@@ -17,6 +17,8 @@ public:
              std::pair<unsigned int, unsigned int> val2, std::pair<unsigned int, unsigned int> val3);
     void add(const std::string &key, unsigned long val1, unsigned long val2);
     void add(const std::string &key, float val);
+    // entries of other whose keys are not set here
+    void merge(const ExifData &other);
 
 private:
     class ExifDataImpl *d_ptr;
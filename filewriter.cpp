@@ -1 +1,43 @@
 #include "filewriter.h"
+
+#include <QDebug>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+std::shared_ptr<AVFrame> FileWriter::cropped(const AVFrame *frm, const QRect &area)
+{
+    std::shared_ptr<AVFrame> view(av_frame_clone(frm), [](AVFrame *f) {
+        av_frame_free(&f);
+    });
+    if (!view || area.isNull())
+        return view;
+
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(frm->format));
+    if (!desc)
+        return nullptr;
+
+    // whole chroma samples only, so every plane starts on the same pixel
+    const int alignW = 1 << desc->log2_chroma_w, alignH = 1 << desc->log2_chroma_h;
+    const auto within = area.intersected(QRect(0, 0, frm->width, frm->height));
+    if (within.isEmpty())
+        return nullptr;
+
+    const int left = within.left() / alignW * alignW, top = within.top() / alignH * alignH;
+    const int right = qMin((within.right() + alignW) / alignW * alignW, frm->width);
+    const int bottom = qMin((within.bottom() + alignH) / alignH * alignH, frm->height);
+
+    view->crop_left = left;
+    view->crop_top = top;
+    view->crop_right = frm->width - right;
+    view->crop_bottom = frm->height - bottom;
+
+    // moves the plane pointers, no pixel is copied
+    if (av_frame_apply_cropping(view.get(), AV_FRAME_CROP_UNALIGNED) < 0) {
+        qCritical() << "cannot crop frame to" << area;
+        return nullptr;
+    }
+
+    return view;
+}
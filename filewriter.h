@@ -2,6 +2,9 @@
 #define FILEWRITER_H
 
 #include <future>
+#include <memory>
+#include <QByteArray>
+#include <QRect>
 #include <QString>
 #include "exiv2wrapper/exiv2wrapper.h"
 #include "colorparams.h"
@@ -12,9 +15,19 @@ extern "C" {
 class FileWriter
 {
 public:
+    // crop limits the image to an area of frm, a null rectangle keeps the whole frame
     virtual bool save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
-                      ColorParams &colr, ExifData &exifData) = 0;
+                      ColorParams &colr, ExifData &exifData, const QRect &crop = QRect()) = 0;
     virtual ~FileWriter() {};
+
+    // saves append the encoded file to buffer instead of writing fileName, while set
+    void setBuffer(QByteArray *buffer) {this->buffer = buffer;};
+
+    // view of area widened to the chroma grid, sharing the buffers of frm
+    static std::shared_ptr<AVFrame> cropped(const AVFrame *frm, const QRect &area);
+
+protected:
+    QByteArray *buffer = nullptr;
 };
 
 #endif // FILEWRITER_H
@@ -0,0 +1,216 @@
+#include "fragmentindex.h"
+
+#include <QDebug>
+#include <algorithm>
+
+// body and end of the box at pos, false if it does not end within rangeEnd (yet)
+static bool readBox(AVIOContext *ctx, int64_t pos, int64_t rangeEnd, int64_t &body, int64_t &end, uint32_t &type)
+{
+    if (pos + 8 > rangeEnd || avio_seek(ctx, pos, SEEK_SET) < 0)
+        return false;
+
+    uint64_t size = avio_rb32(ctx);
+    type = avio_rb32(ctx);
+    body = pos + 8;
+    if (size == 1) {
+        size = avio_rb64(ctx);
+        body += 8;
+    }
+    else if (size == 0) {
+        // extends to the end of the file, which is still being written
+        return false;
+    }
+
+    end = pos + int64_t(size);
+    return !avio_feof(ctx) && size >= uint64_t(body - pos) && end <= rangeEnd;
+}
+
+FragmentIndex::FragmentIndex() : parsedEnd(0), fragmented(false), currentTrack(0)
+{
+}
+
+bool FragmentIndex::update(AVIOContext *ctx)
+{
+    // a box cut off by the end of the file is parsed once it is complete
+    const auto size = avio_size(ctx);
+    bool added = false;
+
+    int64_t body, end;
+    uint32_t type;
+    while (readBox(ctx, parsedEnd, size, body, end, type)) {
+        if (type == 'moov')
+            readHeader(ctx, body, end);
+        else if (type == 'moof')
+            added = readFragment(ctx, parsedEnd, body, end) || added;
+
+        parsedEnd = end;
+    }
+
+    return added;
+}
+
+bool FragmentIndex::update(const QString &fileName)
+{
+    AVIOContext *pb = nullptr;
+    if (avio_open(&pb, fileName.toLocal8Bit(), AVIO_FLAG_READ) < 0) {
+        qWarning() << "cannot read" << fileName;
+        return false;
+    }
+
+    const auto added = update(pb);
+    avio_closep(&pb);
+
+    return added;
+}
+
+int64_t FragmentIndex::end(uint32_t trackID) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const auto track = tracks.find(trackID);
+    return track != tracks.end() ? track->second.end : 0;
+}
+
+std::vector<FragmentIndex::Sample> FragmentIndex::samples(uint32_t trackID) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    const auto track = tracks.find(trackID);
+    return track != tracks.end() ? track->second.samples : std::vector<Sample>();
+}
+
+void FragmentIndex::readHeader(AVIOContext *ctx, int64_t pos, int64_t rangeEnd)
+{
+    int64_t body, end;
+    uint32_t type;
+    for (; readBox(ctx, pos, rangeEnd, body, end, type); pos = end) {
+        switch (type) {
+            case 'mvex':
+                fragmented = true;
+                readHeader(ctx, body, end);
+                break;
+            case 'trak':
+            case 'mdia':
+                readHeader(ctx, body, end);
+                break;
+            case 'tkhd': {
+                const auto ver = avio_r8(ctx);
+                avio_skip(ctx, 3 + (ver == 1 ? 16 : 8)); // flags, creation and modification time
+                currentTrack = avio_rb32(ctx);
+                break;
+            }
+            case 'mdhd': {
+                // samples in the header itself, usually none
+                const auto ver = avio_r8(ctx);
+                avio_skip(ctx, 3 + (ver == 1 ? 16 : 8) + 4); // flags, times, timescale
+                const int64_t duration = ver == 1 ? avio_rb64(ctx) : avio_rb32(ctx);
+
+                std::lock_guard<std::mutex> lock(mtx);
+                if (ver == 1 || duration != 0xffffffff)
+                    tracks[currentTrack].end = duration;
+                break;
+            }
+            case 'trex': {
+                avio_skip(ctx, 4); // version, flags
+                const auto track = avio_rb32(ctx);
+                avio_skip(ctx, 4); // sample description index
+                const auto duration = avio_rb32(ctx);
+                const auto size = avio_rb32(ctx);
+
+                std::lock_guard<std::mutex> lock(mtx);
+                tracks[track].defaultDuration = duration;
+                tracks[track].defaultSize = size;
+                break;
+            }
+        }
+    }
+}
+
+bool FragmentIndex::readFragment(AVIOContext *ctx, int64_t moofPos, int64_t pos, int64_t rangeEnd)
+{
+    // without an explicit base the data of a track fragment follows that of the previous one
+    int64_t dataEnd = moofPos;
+    bool added = false;
+
+    int64_t body, end;
+    uint32_t type;
+    for (; readBox(ctx, pos, rangeEnd, body, end, type); pos = end) {
+        if (type != 'traf')
+            continue;
+
+        uint32_t track = 0, duration = 0, size = 0;
+        int64_t base = dataEnd, offset = dataEnd, decodeTime = -1;
+        std::vector<Sample> samples;
+
+        int64_t boxBody, boxEnd;
+        uint32_t boxType;
+        for (auto box = body; readBox(ctx, box, end, boxBody, boxEnd, boxType); box = boxEnd) {
+            if (boxType == 'tfhd') {
+                const auto flags = avio_rb32(ctx) & 0xffffff;
+                track = avio_rb32(ctx);
+
+                // tracks are only added by this thread
+                const auto known = tracks.find(track);
+                if (known != tracks.end()) {
+                    duration = known->second.defaultDuration;
+                    size = known->second.defaultSize;
+                }
+
+                if (flags & 0x1)
+                    base = avio_rb64(ctx);
+                else if (flags & 0x20000) // default-base-is-moof
+                    base = moofPos;
+                if (flags & 0x2)
+                    avio_skip(ctx, 4); // sample description index
+                if (flags & 0x8)
+                    duration = avio_rb32(ctx);
+                if (flags & 0x10)
+                    size = avio_rb32(ctx);
+
+                offset = base;
+            }
+            else if (boxType == 'tfdt') {
+                const auto ver = avio_r8(ctx);
+                avio_skip(ctx, 3);
+                decodeTime = ver == 1 ? avio_rb64(ctx) : avio_rb32(ctx);
+            }
+            else if (boxType == 'trun') {
+                const auto flags = avio_rb32(ctx) & 0xffffff;
+                const auto count = avio_rb32(ctx);
+                if (flags & 0x1)
+                    offset = base + int32_t(avio_rb32(ctx));
+                if (flags & 0x4)
+                    avio_skip(ctx, 4); // first sample flags
+
+                for (uint32_t i = 0; i < count && !avio_feof(ctx); i++) {
+                    Sample sample {uint64_t(offset), size, duration};
+                    if (flags & 0x100)
+                        sample.duration = avio_rb32(ctx);
+                    if (flags & 0x200)
+                        sample.size = avio_rb32(ctx);
+                    if (flags & 0x400)
+                        avio_skip(ctx, 4); // sample flags
+                    if (flags & 0x800)
+                        avio_skip(ctx, 4); // composition time offset
+
+                    offset += sample.size;
+                    samples.push_back(sample);
+                }
+            }
+        }
+
+        dataEnd = offset;
+        if (samples.empty())
+            continue;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        auto &known = tracks[track];
+        auto time = decodeTime >= 0 ? decodeTime : known.end;
+        for (const auto &sample: samples)
+            time += sample.duration;
+
+        known.end = std::max(known.end, time);
+        known.samples.insert(known.samples.end(), samples.begin(), samples.end());
+        added = true;
+    }
+
+    return added;
+}
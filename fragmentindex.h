@@ -0,0 +1,59 @@
+#ifndef FRAGMENTINDEX_H
+#define FRAGMENTINDEX_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <QString>
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+// sample tables of fragmented MP4 files (moof/traf/trun), extended by the fragments appended since the last
+// update so recordings can be read while they are written. Updates come from one thread, lookups from any.
+class FragmentIndex
+{
+public:
+    struct Sample {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t duration;
+    };
+
+    FragmentIndex();
+    FragmentIndex(const FragmentIndex &) = delete;
+
+    // parses the complete top-level boxes after the last one parsed, true if fragments were added
+    bool update(AVIOContext *ctx);
+    bool update(const QString &fileName);
+
+    // the header announces fragments
+    bool isFragmented() const {return fragmented;};
+    // end of the boxes parsed so far
+    int64_t parsed() const {return parsedEnd;};
+
+    // end of the last sample in the track's timescale, the time base libavformat gives its stream
+    int64_t end(uint32_t trackID) const;
+    // samples of all fragments parsed so far, in file order
+    std::vector<Sample> samples(uint32_t trackID) const;
+
+protected:
+    struct Track {
+        int64_t end = 0;
+        uint32_t defaultDuration = 0, defaultSize = 0; // from trex
+        std::vector<Sample> samples;
+    };
+
+    // samples and ends, protected by mtx; the rest belongs to the updating thread
+    mutable std::mutex mtx;
+    std::map<uint32_t, Track> tracks;
+    int64_t parsedEnd;
+    bool fragmented;
+    uint32_t currentTrack;
+
+    void readHeader(AVIOContext *ctx, int64_t pos, int64_t rangeEnd);
+    bool readFragment(AVIOContext *ctx, int64_t moofPos, int64_t pos, int64_t rangeEnd);
+};
+
+#endif // FRAGMENTINDEX_H
@@ -0,0 +1,96 @@
+#include "framepicker.h"
+
+#include <QtGlobal>
+#include "jobscheduler.h"
+
+FramePicker::FramePicker(Score score) :
+    score(score), bestScore(0), added(0)
+{
+    maxInFlight = qMax(JobScheduler::shared().size(), 1);
+}
+
+FramePicker::~FramePicker()
+{
+    reset();
+}
+
+void FramePicker::add(const AVFrame *frm, const QString &label)
+{
+    push(frm, label, score, std::launch::async);
+}
+
+void FramePicker::add(const AVFrame *frm, double value, const QString &label)
+{
+    // scored by the caller already
+    push(frm, label, [value](const AVFrame *) {
+        return value;
+    }, std::launch::deferred);
+}
+
+void FramePicker::push(const AVFrame *frm, const QString &label, Score fn, std::launch policy)
+{
+    // a reference only, decoding goes on into the caller's frame
+    std::shared_ptr<AVFrame> ref(av_frame_clone(frm), [](AVFrame *f) {
+        av_frame_free(&f);
+    });
+    if (!ref)
+        return;
+
+    // bound the number of frames held while scoring
+    settle(maxInFlight - 1);
+
+    // the user waits for the pick
+    const auto scoring = [fn, ref]() {
+        return fn(ref.get());
+    };
+    inFlight.push_back({ref, label, policy == std::launch::async ?
+                        JobScheduler::shared().offload(scoring, JobScheduler::Priority::Interactive) :
+                        std::async(std::launch::deferred, scoring)});
+    added++;
+}
+
+bool FramePicker::take(AVFrame *frm, QString *label, double *score)
+{
+    settle(0);
+
+    if (!best.frm) {
+        reset();
+        return false;
+    }
+
+    av_frame_unref(frm);
+    av_frame_ref(frm, best.frm.get());
+    if (label)
+        *label = best.label;
+    if (score)
+        *score = bestScore;
+
+    reset();
+    return true;
+}
+
+void FramePicker::reset()
+{
+    for (auto &cand: inFlight)
+        cand.score.wait();
+
+    inFlight.clear();
+    best = Candidate();
+    bestScore = 0;
+    added = 0;
+}
+
+void FramePicker::settle(size_t keep)
+{
+    // in arrival order, so ties go to the earlier frame
+    while (inFlight.size() > keep) {
+        auto &cand = inFlight.front();
+        const auto value = cand.score.get();
+        if (!best.frm || value > bestScore) {
+            best = std::move(cand);
+            bestScore = value;
+        }
+
+        inFlight.pop_front();
+    }
+}
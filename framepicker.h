@@ -0,0 +1,47 @@
+#ifndef FRAMEPICKER_H
+#define FRAMEPICKER_H
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <QString>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// keeps the best scoring of a series of frames, scoring them in parallel as they arrive
+class FramePicker
+{
+public:
+    using Score = std::function<double(const AVFrame *)>;
+
+    explicit FramePicker(Score score);
+    FramePicker(const FramePicker &) = delete;
+    ~FramePicker();
+
+    void add(const AVFrame *frm, const QString &label = QString());
+    void add(const AVFrame *frm, double value, const QString &label = QString());
+    bool take(AVFrame *frm, QString *label = nullptr, double *score = nullptr);
+    void reset();
+    int count() const {return added;};
+
+protected:
+    struct Candidate {
+        std::shared_ptr<AVFrame> frm;
+        QString label;
+        std::future<double> score;
+    };
+
+    Score score;
+    std::deque<Candidate> inFlight;
+    Candidate best;
+    double bestScore;
+    int added, maxInFlight;
+
+    void settle(size_t keep);
+    void push(const AVFrame *frm, const QString &label, Score fn, std::launch policy);
+};
+
+#endif // FRAMEPICKER_H
@@ -0,0 +1,142 @@
+#include "framepool.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+std::atomic<int64_t> FramePool::resident(0);
+
+FramePool::FramePool() : allocCount(0), allocBytes(0)
+{
+}
+
+FramePool::~FramePool()
+{
+    release();
+}
+
+void FramePool::attach(AVCodecContext *codecCtx)
+{
+    // decoders without direct rendering support keep allocating on their own
+    if (!codecCtx->codec || !(codecCtx->codec->capabilities & AV_CODEC_CAP_DR1))
+        return;
+
+    codecCtx->opaque = this;
+    codecCtx->get_buffer2 = getBuffer;
+}
+
+void FramePool::release()
+{
+    // pools are freed once the last outstanding buffer returns
+    std::lock_guard<std::mutex> lock(mtx);
+    for (auto &pool: pools)
+        av_buffer_pool_uninit(&pool.second);
+
+    pools.clear();
+}
+
+int FramePool::getBuffer(AVCodecContext *codecCtx, AVFrame *frm, int flags)
+{
+    const auto self = static_cast<FramePool *>(codecCtx->opaque);
+    const auto fmt = static_cast<AVPixelFormat>(frm->format);
+    const auto desc = av_pix_fmt_desc_get(fmt);
+    if (!self || !desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+        return avcodec_default_get_buffer2(codecCtx, frm, flags);
+
+    // padded dimensions as the decoder expects them
+    int w = frm->width, h = frm->height;
+    int strideAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(codecCtx, &w, &h, strideAlign);
+
+    // widen until every stride is aligned, keeping the ratio between planes intact
+    int linesize[4];
+    bool aligned;
+    do {
+        if (av_image_fill_linesizes(linesize, fmt, w) < 0)
+            return avcodec_default_get_buffer2(codecCtx, frm, flags);
+
+        w += w & ~(w - 1);
+
+        aligned = true;
+        for (int i = 0; i < 4; i++)
+            aligned &= linesize[i] % align == 0 && linesize[i] % std::max(strideAlign[i], 1) == 0;
+    } while (!aligned);
+
+    ptrdiff_t strides[4];
+    size_t sizes[4];
+    std::copy(linesize, linesize + 4, strides);
+    if (av_image_fill_plane_sizes(sizes, fmt, h, strides) < 0)
+        return avcodec_default_get_buffer2(codecCtx, frm, flags);
+
+    memset(frm->data, 0, sizeof(frm->data));
+    memset(frm->linesize, 0, sizeof(frm->linesize));
+
+    for (int i = 0; i < 4 && sizes[i]; i++) {
+        // same slack for overreading decoders as libavcodec's internal pool provides
+        frm->buf[i] = self->get(sizes[i] + 16 + align - 1);
+        if (!frm->buf[i]) {
+            av_frame_unref(frm);
+            return AVERROR(ENOMEM);
+        }
+
+        const auto addr = reinterpret_cast<uintptr_t>(frm->buf[i]->data);
+        frm->data[i] = frm->buf[i]->data + ((align - addr % align) % align);
+        frm->linesize[i] = linesize[i];
+    }
+    frm->extended_data = frm->data;
+
+    return 0;
+}
+
+AVBufferRef *FramePool::alloc(void *opaque, size_t size)
+{
+    const auto self = static_cast<FramePool *>(opaque);
+
+    // the size travels with the buffer, which may outlive the pool
+    auto data = static_cast<uint8_t *>(av_malloc(size));
+    auto buf = data ? av_buffer_create(data, size, freeBuffer, reinterpret_cast<void *>(size), 0) : nullptr;
+    if (!buf) {
+        av_free(data);
+        return nullptr;
+    }
+
+    self->allocCount++;
+    self->allocBytes += size;
+    resident += size;
+
+    return buf;
+}
+
+void FramePool::freeBuffer(void *opaque, uint8_t *data)
+{
+    resident -= reinterpret_cast<size_t>(opaque);
+    av_free(data);
+}
+
+size_t FramePool::sizeClass(size_t size)
+{
+    // eight classes per power of two bound the slack to 12.5%
+    size_t msb = 1;
+    while ((msb << 1) <= size)
+        msb <<= 1;
+
+    const auto step = std::max<size_t>(msb / 8, 4096);
+    return (size + step - 1) / step * step;
+}
+
+AVBufferRef *FramePool::get(size_t size)
+{
+    const auto cls = sizeClass(size);
+
+    // under the lock, release() must not uninit the pool before the buffer holds its reference
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &entry = pools[cls];
+    if (!entry)
+        entry = av_buffer_pool_init2(cls, this, alloc, nullptr);
+
+    return entry ? av_buffer_pool_get(entry) : nullptr;
+}
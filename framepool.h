@@ -0,0 +1,44 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// recycled, ref-counted frame buffers for decoders, bucketed by size class
+class FramePool
+{
+public:
+    // alignment of plane starts and strides, sufficient for AVX-512 and NEON loads
+    static constexpr int align = 64;
+
+    FramePool();
+    FramePool(const FramePool &) = delete;
+    ~FramePool();
+
+    void attach(AVCodecContext *codecCtx);
+    void release();
+
+    uint64_t allocations() const {return allocCount;};
+    uint64_t allocatedBytes() const {return allocBytes;};
+    // bytes of frame buffers currently allocated by all pools of the process, in use or idle
+    static int64_t residentBytes() {return resident;};
+
+protected:
+    std::mutex mtx;
+    std::map<size_t, AVBufferPool *> pools;
+    std::atomic<uint64_t> allocCount, allocBytes;
+    static std::atomic<int64_t> resident;
+
+    static int getBuffer(AVCodecContext *codecCtx, AVFrame *frm, int flags);
+    static AVBufferRef *alloc(void *opaque, size_t size);
+    static void freeBuffer(void *opaque, uint8_t *data);
+    static size_t sizeClass(size_t size);
+    AVBufferRef *get(size_t size);
+};
+
+#endif // FRAMEPOOL_H
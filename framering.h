@@ -0,0 +1,87 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+// layout of the shared memory frame ring, shared with reader processes; no Qt or FFmpeg in here
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+namespace FrameRing {
+
+constexpr uint32_t magic = 0x52534956; // "VISR"
+constexpr uint32_t version = 1;
+constexpr const char *defaultName = "/visie-frames";
+
+// slots start this far into the mapping
+constexpr uint64_t slotsOffset = 4096;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "ring counters must work across processes");
+
+struct alignas(64) RingHeader {
+    uint32_t magic, version;
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotBytes;              // distance between slots
+    std::atomic<uint64_t> published; // frames published so far, frame n is in slot n % slotCount
+    std::atomic<uint32_t> wakeup;    // futex word, bumped on every publish
+    std::atomic<uint32_t> closed;    // the writer is gone or replaced the ring, reopen by name
+};
+
+struct alignas(64) SlotHeader {
+    std::atomic<uint64_t> seq; // 2n + 1 while frame n is written, 2n + 2 once complete
+    int64_t pts;
+    int32_t timeBaseNum, timeBaseDen;
+    int32_t width, height;
+    int32_t format; // AVPixelFormat
+    int32_t planes;
+    int32_t linesize[4];
+    int32_t rows[4];
+    uint64_t planeOffset[4]; // from the start of the slot
+    int32_t primaries, transfer, matrix;
+    uint32_t exifSize;
+    uint64_t exifOffset;     // serialized Exif block, TIFF header first
+};
+
+inline SlotHeader *slotAt(void *base, const RingHeader *hdr, uint64_t n)
+{
+    return reinterpret_cast<SlotHeader *>(static_cast<uint8_t *>(base) + slotsOffset +
+                                          (n % hdr->slotCount) * hdr->slotBytes);
+}
+
+// blocks while *word still holds expected, at most timeoutMs
+inline void waitFor(std::atomic<uint32_t> *word, uint32_t expected, int timeoutMs)
+{
+#ifdef __linux__
+    timespec ts {timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    // no cross-process wait primitive to rely on, poll
+    for (int i = 0; i < timeoutMs && word->load(std::memory_order_acquire) == expected; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+}
+
+inline void wakeAll(std::atomic<uint32_t> *word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+}
+
+#endif // FRAMERING_H
@@ -0,0 +1,322 @@
+#include "frameserver.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "heifwriter.h"
+#include "jobscheduler.h"
+#include "streamwriter.h"
+#include "videoprocessor.h"
+
+FrameServer::FrameServer(size_t videos, int workers) : cache(videos, workers), fd(-1), stopping(false)
+{
+    for (int w = 0; w < qMax(workers, 1); w++) {
+        this->workers.emplace_back(new Worker);
+        const auto worker = this->workers.back().get();
+        worker->thread = std::thread(&FrameServer::work, this, worker);
+    }
+}
+
+FrameServer::~FrameServer()
+{
+    // stop accepting and hang up on clients, their threads finish with requests in progress
+    stopping = true;
+    if (fd >= 0)
+        shutdown(fd, SHUT_RDWR);
+
+    {
+        std::unique_lock<std::mutex> lock(connMtx);
+        for (const auto &conn: connections)
+            shutdown(conn.first, SHUT_RDWR);
+
+        connCond.wait(lock, [this]() {
+            return finished.size() == connections.size();
+        });
+        reap();
+    }
+
+    for (auto &worker: workers) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mtx);
+            worker->stop = true;
+        }
+        worker->cond.notify_one();
+        worker->thread.join();
+    }
+
+    if (fd >= 0)
+        ::close(fd);
+}
+
+bool FrameServer::listen(const QString &path)
+{
+    const auto name = path.toLocal8Bit();
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (size_t(name.size()) >= sizeof(addr.sun_path)) {
+        qCritical() << "socket path too long:" << path;
+        return false;
+    }
+    memcpy(addr.sun_path, name.constData(), name.size());
+
+    // a socket left behind by an earlier run
+    struct stat st;
+    if (lstat(name.constData(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(name.constData());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 16) < 0) {
+        qCritical() << "cannot listen on" << path << ":" << strerror(errno);
+        return false;
+    }
+
+    // frames of the user's videos are for the user only
+    chmod(name.constData(), 0600);
+
+    qInfo() << "serving frames on" << path;
+    return true;
+}
+
+void FrameServer::run()
+{
+    // a client hanging up mid-reply must not end the server
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(connMtx);
+            connCond.wait(lock, [this]() {
+                return stopping || !finished.empty() || int(connections.size()) < maxConnections;
+            });
+            reap();
+        }
+        if (stopping)
+            return;
+
+        const auto conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (stopping)
+                return;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            qCritical() << "accepting connections failed:" << strerror(errno);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(connMtx);
+        if (stopping) {
+            ::close(conn);
+            return;
+        }
+        connections.emplace(conn, std::thread(&FrameServer::serve, this, conn));
+    }
+}
+
+void FrameServer::reap()
+{
+    // the socket is closed only here, so its number cannot be reused by a connection still in the map
+    for (const auto conn: finished) {
+        const auto it = connections.find(conn);
+        it->second.join();
+        connections.erase(it);
+        ::close(conn);
+    }
+
+    finished.clear();
+}
+
+void FrameServer::work(Worker *worker)
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(worker->mtx);
+            worker->cond.wait(lock, [worker]() {
+                return worker->stop || !worker->tasks.empty();
+            });
+            if (worker->tasks.empty())
+                return;
+
+            task = std::move(worker->tasks.front());
+            worker->tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void FrameServer::serve(int conn)
+{
+    // requests on a connection are answered in order
+    while (true) {
+        uint32_t size;
+        if (!readAll(conn, reinterpret_cast<char *>(&size), sizeof(size)))
+            break;
+
+        size = qFromBigEndian(size);
+        Reply reply;
+        if (size > maxRequest) {
+            reply = Reply {BadRequest, "request too large"};
+        }
+        else {
+            QByteArray request(int(size), Qt::Uninitialized);
+            if (!readAll(conn, request.data(), size))
+                break;
+
+            reply = handle(request);
+        }
+
+        const uint32_t header[2] = {qToBigEndian(uint32_t(sizeof(uint32_t) + reply.data.size())),
+                                    qToBigEndian(uint32_t(reply.status))};
+        if (!writeAll(conn, reinterpret_cast<const char *>(header), sizeof(header)) ||
+            !writeAll(conn, reply.data.constData(), reply.data.size()) || size > maxRequest)
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connMtx);
+        finished.push_back(conn);
+    }
+    connCond.notify_all();
+}
+
+FrameServer::Reply FrameServer::handle(const QByteArray &request)
+{
+    const auto doc = QJsonDocument::fromJson(request);
+    const auto obj = doc.object();
+    const auto file = obj["file"].toString();
+    const auto format = obj["format"].toString("heic");
+    if (!doc.isObject() || file.isEmpty() || !obj["time"].isDouble() || (format != "heic" && format != "y4m"))
+        return Reply {BadRequest, "expected {\"file\": path, \"time\": seconds, \"format\": \"heic\" or \"y4m\"}"};
+
+    const auto time = obj["time"].toDouble();
+    const auto heic = format == "heic";
+    const auto video = cache.acquire(QFileInfo(file).absoluteFilePath());
+
+    // shared with the queued call, which may run after this connection gave up waiting
+    const auto task = std::make_shared<std::packaged_task<Reply()>>([this, video, time, heic]() {
+        if (!video->isOpen()) {
+            try {
+                video->open();
+            }
+            catch (QString msg) {
+                cache.drop(video);
+                return Reply {OpenFailed, (video->fileName + ": " + msg).toUtf8()};
+            }
+        }
+
+        return extract(*video, time, heic);
+    });
+    auto result = task->get_future();
+
+    const auto worker = workers[video->worker].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->mtx);
+        worker->tasks.push_back([task]() {
+            (*task)();
+        });
+    }
+    worker->cond.notify_one();
+
+    return result.get();
+}
+
+FrameServer::Reply FrameServer::extract(VideoCache::Video &video, double time, bool heic)
+{
+    auto &src = video.src;
+    const auto strm = src.videoStream();
+    const auto start = strm->start_time != AV_NOPTS_VALUE ? strm->start_time : 0;
+    const auto pts = start + av_rescale_q(int64_t(time * AV_TIME_BASE), AV_TIME_BASE_Q, strm->time_base);
+
+    // the frame returned last may be the one asked for, or lie shortly before it
+    const auto frm = video.frame;
+    const auto cur = frm->format != -1 ? FrameSource::ptsOf(frm) : AV_NOPTS_VALUE;
+    const auto window = av_rescale_q(forwardSeconds, AVRational{1, 1}, strm->time_base);
+
+    bool found;
+    if (cur != AV_NOPTS_VALUE && pts >= cur && pts < cur + src.frameDuration())
+        found = true;
+    else if (cur != AV_NOPTS_VALUE && src.lastPts() == cur && pts > cur && pts - cur <= window)
+        found = src.advance(pts, frm);
+    else
+        found = src.seek(pts, frm);
+
+    if (!found)
+        return Reply {NoFrame, QString("no frame at %1 s").arg(time).toUtf8()};
+
+    Reply reply {Ok, QByteArray()};
+    ExifData exif;
+    QString icc;
+    ColorParams color;
+
+    bool success;
+    if (heic) {
+        const VideoProcessor::StreamInfo info {video.fileName, strm->id, strm->time_base, src.rotation(), nullptr};
+        const auto sub = video.subs.text();
+        auto meta = JobScheduler::shared().offload([&]() {
+            VideoProcessor::extractMeta(frm, info, exif, icc, color, video.meta);
+            VideoProcessor::addSubtitleMeta(sub, exif);
+        });
+
+        HeifWriter writer;
+        writer.setBuffer(&reply.data);
+        success = writer.save(frm, QString(), meta, icc, color, exif);
+    }
+    else {
+        auto meta = std::async(std::launch::deferred, []() {});
+
+        StreamWriter writer(StreamWriter::Format::Y4M);
+        writer.setSource(video.fileName, strm->avg_frame_rate, strm->time_base);
+        writer.setBuffer(&reply.data);
+        success = writer.save(frm, QString(), meta, icc, color, exif);
+    }
+
+    if (!success)
+        return Reply {EncodeFailed, "encoding failed"};
+
+    return reply;
+}
+
+bool FrameServer::readAll(int conn, char *data, size_t size)
+{
+    while (size) {
+        const auto done = ::read(conn, data, size);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+
+        data += done;
+        size -= size_t(done);
+    }
+
+    return true;
+}
+
+bool FrameServer::writeAll(int conn, const char *data, size_t size)
+{
+    while (size) {
+        const auto done = ::write(conn, data, size);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done < 0)
+            return false;
+
+        data += done;
+        size -= size_t(done);
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include "videocache.h"
+
+// answers frame requests over a Unix domain socket from videos kept open between requests.
+// Messages are a 32-bit big endian length followed by that many bytes. Requests are JSON,
+// {"file": path, "time": seconds, "format": "heic" or "y4m"}; replies start with a 32-bit big
+// endian status, 0 for success, followed by the image or an error text.
+class FrameServer
+{
+public:
+    FrameServer(size_t videos, int workers);
+    FrameServer(const FrameServer &) = delete;
+    ~FrameServer();
+
+    bool listen(const QString &path);
+    // accepts connections until the socket fails or the server is destroyed, each one served on its own thread
+    void run();
+
+protected:
+    // requests larger than this are rejected
+    static constexpr uint32_t maxRequest = 64 * 1024;
+    // connections served at once, further clients wait in the listen backlog
+    static constexpr int maxConnections = 32;
+    // later frames within this distance are decoded on instead of seeking
+    static constexpr int forwardSeconds = 2;
+
+    enum Status : uint32_t {
+        Ok,
+        BadRequest,
+        OpenFailed,
+        NoFrame,
+        EncodeFailed
+    };
+
+    struct Reply {
+        Status status;
+        QByteArray data;
+    };
+
+    // decoders are used by one thread each, every video is served by the same worker
+    struct Worker {
+        std::thread thread;
+        std::mutex mtx;
+        std::condition_variable cond;
+        std::deque<std::function<void()>> tasks;
+        bool stop = false;
+    };
+
+    VideoCache cache;
+    std::vector<std::unique_ptr<Worker>> workers;
+    int fd;
+
+    // threads of open connections by socket, the finished ones are joined and closed by reap()
+    std::mutex connMtx;
+    std::condition_variable connCond;
+    std::map<int, std::thread> connections;
+    std::vector<int> finished;
+    std::atomic<bool> stopping;
+
+    void work(Worker *worker);
+    void serve(int conn);
+    void reap();
+    Reply handle(const QByteArray &request);
+    Reply extract(VideoCache::Video &video, double time, bool heic);
+
+    static bool readAll(int conn, char *data, size_t size);
+    static bool writeAll(int conn, const char *data, size_t size);
+};
+
+#endif // FRAMESERVER_H
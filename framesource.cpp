@@ -0,0 +1,447 @@
+#include "framesource.h"
+
+#include <QDebug>
+#include <cstring>
+#include "threadbudget.h"
+#include "tracer.h"
+
+// decoder calls, traced
+static int sendPacket(AVCodecContext *codecCtx, const AVPacket *pkt)
+{
+    Tracer::Span span("avcodec_send_packet");
+    return avcodec_send_packet(codecCtx, pkt);
+}
+
+static int receiveFrame(AVCodecContext *codecCtx, AVFrame *frm)
+{
+    Tracer::Span span("avcodec_receive_frame");
+    return avcodec_receive_frame(codecCtx, frm);
+}
+
+FrameSource::FrameSource() :
+    ctx(nullptr), codecCtx(nullptr), videoStrm(-1), hasPending(false), eof(false), keyframesOnly(false),
+    exportMvs(false), fastOpen(true), probing(false), primed(false), threads(0), last(AV_NOPTS_VALUE),
+    skipping(true), skipBefore(AV_NOPTS_VALUE)
+{
+    pkt = av_packet_alloc();
+    scratch = av_frame_alloc();
+    pending = av_frame_alloc();
+}
+
+FrameSource::~FrameSource()
+{
+    close();
+
+    av_packet_free(&pkt);
+    av_frame_free(&scratch);
+    av_frame_free(&pending);
+}
+
+void FrameSource::open(const QString &fn, FramePool *pool)
+{
+    // probing decodes packets of every stream, which takes seconds for large files on slow media
+    if (!fastOpen || !open(fn, pool, false))
+        open(fn, pool, true);
+}
+
+bool FrameSource::open(const QString &fn, FramePool *pool, bool probe)
+{
+    close();
+
+    const AVCodec *videoCodec;
+
+    // open file
+    if (avformat_open_input(&ctx, fn.toLocal8Bit(), NULL, NULL) != 0)
+        throw QString("Cannot open file");
+
+    try {
+        // access video stream
+        if (probe && avformat_find_stream_info(ctx, NULL) < 0)
+            throw QString("Cannot read video stream info");
+
+        videoStrm = av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &videoCodec, 0);
+        if (videoStrm < 0) {
+            if (videoStrm == AVERROR_STREAM_NOT_FOUND)
+                throw QString("Video stream not found");
+            else if (videoStrm == AVERROR_DECODER_NOT_FOUND)
+                throw QString("Decoder not found");
+            else
+                throw QString("Video stream not found: unknown error");
+        }
+
+        if (!probe && !described()) {
+            close();
+            return false;
+        }
+
+        // establish codec
+        codecCtx = avcodec_alloc_context3(videoCodec);
+        if (!codecCtx)
+            throw QString("cannot create codec context");
+
+        avcodec_parameters_to_context(codecCtx, ctx->streams[videoStrm]->codecpar);
+        if (pool)
+            pool->attach(codecCtx);
+        if (exportMvs)
+            codecCtx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+        codecCtx->thread_count = threads > 0 ? threads : ThreadBudget::decoder();
+
+        if (avcodec_open2(codecCtx, videoCodec, nullptr) < 0)
+            throw QString("cannot open codec %1").arg(videoCodec->long_name);
+
+        // parameters taken from the header are proven by the first frame
+        if (!probe && !prime())
+            throw QString("no frame decoded");
+    }
+    catch (QString msg) {
+        close();
+        if (probe)
+            throw;
+
+        qDebug() << "opening without probing failed:" << msg;
+        return false;
+    }
+
+    probing = probe;
+    return true;
+}
+
+bool FrameSource::described() const
+{
+    // The mov demuxer reads codec parameters, dimensions, time base, duration, color and rotation from the moov
+    // box while opening. Probing only adds what decoding the first frame tells anyway.
+    if (!strstr(ctx->iformat->name, "mp4"))
+        return false;
+
+    const auto strm = ctx->streams[videoStrm];
+    const auto par = strm->codecpar;
+    if (par->codec_id == AV_CODEC_ID_NONE || par->width <= 0 || par->height <= 0 || strm->time_base.num <= 0)
+        return false;
+
+    // codecs keeping their parameter sets in the sample description
+    switch (par->codec_id) {
+        case AV_CODEC_ID_H264:
+        case AV_CODEC_ID_HEVC:
+        case AV_CODEC_ID_AV1:
+        case AV_CODEC_ID_MPEG4:
+            return par->extradata_size > 0;
+        default:
+            return true;
+    }
+}
+
+bool FrameSource::prime()
+{
+    auto hook = std::move(packetHook);
+    packetHook = [this](AVPacket *p) {
+        held.push_back(av_packet_clone(p));
+    };
+    const auto decoded = next(pending);
+    packetHook = std::move(hook);
+
+    if (!decoded)
+        return false;
+
+    // kept for the first seek or next(), as if nothing was read yet
+    hasPending = primed = true;
+    last = AV_NOPTS_VALUE;
+    return true;
+}
+
+void FrameSource::unprime(bool taken)
+{
+    for (auto &p: held) {
+        if (taken && packetHook)
+            packetHook(p);
+        av_packet_free(&p);
+    }
+
+    held.clear();
+    primed = false;
+}
+
+void FrameSource::close()
+{
+    if (codecCtx)
+        avcodec_free_context(&codecCtx);
+    if (ctx)
+        avformat_close_input(&ctx);
+
+    av_frame_unref(pending);
+    hasPending = false;
+    unprime(false);
+    eof = false;
+    keyframesOnly = false;
+    videoStrm = -1;
+    last = AV_NOPTS_VALUE;
+    counted = Stats();
+
+    clearQueue();
+}
+
+void FrameSource::setKeyframesOnly(bool on)
+{
+    keyframesOnly = on;
+
+    // lets demuxers that support it skip reading the other samples
+    if (ctx)
+        videoStream()->discard = on ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
+bool FrameSource::rewind(int64_t pts)
+{
+    if (!codecCtx)
+        return false;
+
+    // seek to keyframe
+    {
+        Tracer::Span span("av_seek_frame");
+        if (av_seek_frame(ctx, videoStrm, pts, AVSEEK_FLAG_BACKWARD) < 0) {
+            qWarning() << "cannot seek to frame" << pts;
+            return false;
+        }
+    }
+    avcodec_flush_buffers(codecCtx);
+    codecCtx->skip_frame = AVDISCARD_DEFAULT;
+
+    av_frame_unref(pending);
+    hasPending = false;
+    unprime(false);
+    eof = false;
+    last = AV_NOPTS_VALUE;
+
+    clearQueue();
+
+    return true;
+}
+
+bool FrameSource::seek(int64_t pts, AVFrame *frm)
+{
+    av_frame_unref(frm);
+
+    // the frame decoded while opening is the first one, presented for any target up to it
+    if (primed && pts <= ptsOf(pending)) {
+        av_frame_move_ref(frm, pending);
+        hasPending = false;
+        unprime(true);
+        last = ptsOf(frm);
+        return true;
+    }
+
+    if (!rewind(pts))
+        return false;
+
+    // learn up front which frame will be presented
+    const auto result = skipping ? plan(pts) : AV_NOPTS_VALUE;
+    skipBefore = result;
+
+    // work towards target (intra)frame
+    bool found = false;
+    while (next(scratch)) {
+        if (ptsOf(scratch) > pts && ptsOf(scratch) != result) {
+            // overshot, use last frame if available and keep this one for next()
+            if (found) {
+                av_frame_move_ref(pending, scratch);
+                hasPending = true;
+            }
+            else {
+                av_frame_move_ref(frm, scratch);
+                found = true;
+            }
+            break;
+        }
+
+        av_frame_unref(frm);
+        av_frame_move_ref(frm, scratch);
+        found = true;
+
+        if (ptsOf(frm) == pts || ptsOf(frm) == result) {
+            // target hit
+            break;
+        }
+    }
+
+    last = found ? ptsOf(frm) : AV_NOPTS_VALUE;
+
+    return found;
+}
+
+bool FrameSource::advance(int64_t pts, AVFrame *frm)
+{
+    while (next(scratch)) {
+        if (ptsOf(scratch) > pts) {
+            // overshot, keep it for next()
+            av_frame_move_ref(pending, scratch);
+            hasPending = true;
+            break;
+        }
+
+        av_frame_unref(frm);
+        av_frame_move_ref(frm, scratch);
+    }
+
+    last = frm->format != -1 ? ptsOf(frm) : AV_NOPTS_VALUE;
+    return frm->format != -1;
+}
+
+bool FrameSource::next(AVFrame *frm)
+{
+    if (!codecCtx)
+        return false;
+
+    av_frame_unref(frm);
+
+    if (hasPending) {
+        av_frame_move_ref(frm, pending);
+        hasPending = false;
+        unprime(true);
+        last = ptsOf(frm);
+        return true;
+    }
+
+    while (true) {
+        auto rc = receiveFrame(codecCtx, frm);
+        if (rc == 0) {
+            counted.decoded++;
+            last = ptsOf(frm);
+            return true;
+        }
+        else if (rc != AVERROR(EAGAIN) || eof) {
+            // drained or decoder error
+            return false;
+        }
+
+        // decoder needs input, load next packet
+        if (!readPacket()) {
+            eof = true;
+            sendPacket(codecCtx, nullptr);
+            continue;
+        }
+
+        if (pkt->stream_index != videoStrm) {
+            if (packetHook)
+                packetHook(pkt);
+        }
+        else if (keyframesOnly && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+            // dropped entirely
+        }
+        else if (skipBefore != AV_NOPTS_VALUE && pkt->pts != AV_NOPTS_VALUE && pkt->pts < skipBefore) {
+            // ahead of the presented frame: only reference frames matter. Disposable samples flagged
+            // by the container need not even be parsed, the decoder identifies the rest.
+            if (!(pkt->flags & AV_PKT_FLAG_DISPOSABLE)) {
+                codecCtx->skip_frame = AVDISCARD_NONREF;
+                sendPacket(codecCtx, pkt);
+            }
+        }
+        else {
+            codecCtx->skip_frame = AVDISCARD_DEFAULT;
+            sendPacket(codecCtx, pkt);
+        }
+
+        av_packet_unref(pkt);
+    }
+}
+
+int64_t FrameSource::plan(int64_t pts)
+{
+    // Demux (without decoding) until the decode timestamp passes the target: no later packet can
+    // be presented at or before it then. The last frame not after the target is the one presented.
+    int64_t result = AV_NOPTS_VALUE, first = AV_NOPTS_VALUE;
+    int64_t bytes = 0;
+    bool complete = true;
+
+    while (av_read_frame(ctx, pkt) == 0) {
+        counted.packets++;
+        if (pkt->stream_index != videoStrm) {
+            if (packetHook)
+                packetHook(pkt);
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        const auto dts = pkt->dts;
+        if (pkt->pts == AV_NOPTS_VALUE) {
+            complete = false;
+        }
+        else {
+            if (pkt->pts <= pts && (result == AV_NOPTS_VALUE || pkt->pts > result))
+                result = pkt->pts;
+            if (first == AV_NOPTS_VALUE || pkt->pts < first)
+                first = pkt->pts;
+        }
+
+        bytes += pkt->size;
+        auto queued = av_packet_alloc();
+        av_packet_move_ref(queued, pkt);
+        queue.push_back(queued);
+
+        if (dts != AV_NOPTS_VALUE && dts > pts)
+            break;
+
+        // the queued packets are decoded as read, just without skipping
+        if (int(queue.size()) >= planPackets || bytes >= planBytes)
+            return AV_NOPTS_VALUE;
+    }
+
+    if (!complete)
+        return AV_NOPTS_VALUE;
+
+    // target precedes the first frame, present that one
+    return result != AV_NOPTS_VALUE ? result : first;
+}
+
+bool FrameSource::readPacket()
+{
+    if (queue.empty()) {
+        if (av_read_frame(ctx, pkt) < 0)
+            return false;
+
+        counted.packets++;
+        return true;
+    }
+
+    av_packet_move_ref(pkt, queue.front());
+    av_packet_free(&queue.front());
+    queue.pop_front();
+
+    return true;
+}
+
+void FrameSource::clearQueue()
+{
+    for (auto &p: queue)
+        av_packet_free(&p);
+
+    queue.clear();
+    skipBefore = AV_NOPTS_VALUE;
+}
+
+int64_t FrameSource::frameDuration() const
+{
+    // nominal distance of consecutive frames in stream time base
+    const auto strm = videoStream();
+    const auto rate = strm->avg_frame_rate.num ? strm->avg_frame_rate : strm->r_frame_rate;
+    if (!rate.num || !rate.den)
+        return 1;
+
+    return qMax<int64_t>(av_rescale_q(1, av_inv_q(rate), strm->time_base), 1);
+}
+
+int FrameSource::rotation() const
+{
+    auto rota = av_dict_get(videoStream()->metadata, "rotate", nullptr, 0);
+    return rota ? atoi(rota->value) : 0;
+}
+
+FrameSource::Stats FrameSource::stats() const
+{
+    // I/O as the demuxer did it, including probing and seeking
+    auto result = counted;
+    result.bytes = ctx && ctx->pb ? ctx->pb->bytes_read : 0;
+    return result;
+}
+
+int64_t FrameSource::ptsOf(const AVFrame *frm)
+{
+    return frm->pts != AV_NOPTS_VALUE ? frm->pts : frm->best_effort_timestamp;
+}
@@ -0,0 +1,92 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <deque>
+#include <functional>
+#include <QString>
+#include "framepool.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+// demuxer and decoder for the best video stream of a file
+class FrameSource
+{
+public:
+    // work done since open()
+    struct Stats {
+        int64_t packets = 0, decoded = 0, bytes = 0;
+    };
+
+    FrameSource();
+    FrameSource(const FrameSource &) = delete;
+    ~FrameSource();
+
+    void open(const QString &fn, FramePool *pool = nullptr);
+    void close();
+    bool isOpen() const {return codecCtx != nullptr;};
+    void setSkipping(bool on) {skipping = on;};
+    void setKeyframesOnly(bool on);
+    void setExportMotionVectors(bool on) {exportMvs = on;};
+    // trust the header of MP4/MOV files instead of probing their streams, from the next open(), on by default
+    void setFastOpen(bool on) {fastOpen = on;};
+    // whether the last open() probed the streams
+    bool probed() const {return probing;};
+    // decoder threads from the next open(), 0 for ThreadBudget::decoder()
+    void setThreads(int n) {threads = n;};
+
+    bool rewind(int64_t pts);
+    bool seek(int64_t pts, AVFrame *frm);
+    // like seek() but decoding on from the current position, frm holds the frame returned last
+    bool advance(int64_t pts, AVFrame *frm);
+    bool next(AVFrame *frm);
+
+    AVFormatContext *formatContext() const {return ctx;};
+    AVCodecContext *codecContext() const {return codecCtx;};
+    AVStream *videoStream() const {return ctx->streams[videoStrm];};
+    int stream() const {return videoStrm;};
+    int64_t lastPts() const {return last;};
+    int64_t frameDuration() const;
+    int rotation() const;
+    Stats stats() const;
+
+    static int64_t ptsOf(const AVFrame *frm);
+
+    // invoked for packets of streams other than the video stream
+    std::function<void(AVPacket *)> packetHook;
+
+protected:
+    AVFormatContext *ctx;
+    AVCodecContext *codecCtx;
+    int videoStrm;
+    AVPacket *pkt;
+    AVFrame *scratch, *pending;
+    bool hasPending, eof, keyframesOnly, exportMvs;
+    bool fastOpen, probing, primed; // primed: pending holds the first frame, decoded by open()
+    int threads;
+    int64_t last;
+    Stats counted;
+
+    // seeking with non-reference frames ahead of the presented one left undecoded. Planning holds at most this
+    // much of a GOP in memory, longer ones are decoded without skipping.
+    static constexpr int planPackets = 600;
+    static constexpr int64_t planBytes = 64 << 20;
+    bool skipping;
+    std::deque<AVPacket *> queue;
+    int64_t skipBefore;
+
+    // packets of other streams read while priming, passed to the hook once the first frame is taken
+    std::deque<AVPacket *> held;
+
+    bool open(const QString &fn, FramePool *pool, bool probe);
+    bool described() const;
+    bool prime();
+    void unprime(bool taken);
+    int64_t plan(int64_t pts);
+    bool readPacket();
+    void clearQueue();
+};
+
+#endif // FRAMESOURCE_H
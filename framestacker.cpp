@@ -0,0 +1,476 @@
+#include "framestacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <limits>
+#include "jobscheduler.h"
+#include "pixelkernels.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define STACKER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define STACKER_NEON
+#include <arm_neon.h>
+#endif
+
+AVFrame *FrameStacker::stack(const std::vector<const AVFrame *> &frames, int ref, Mode mode)
+{
+    const int n = frames.size();
+    if (!n || n > maxFrames || ref < 0 || ref >= n)
+        return nullptr;
+
+    const auto base = frames[ref];
+    const auto fmt = AVPixelFormat(base->format);
+    if (!pixelKernels(fmt))
+        return nullptr;
+
+    for (const auto frm: frames) {
+        if (frm->format != base->format || frm->width != base->width || frm->height != base->height)
+            return nullptr;
+    }
+
+    // global translation of every frame against the reference
+    // stacking runs within a save, its parts wait on the pool or run in the saving thread
+    auto &pool = JobScheduler::shared();
+    std::vector<std::future<Pyramid>> building;
+    for (const auto frm: frames) {
+        building.push_back(pool.offload([frm]() {
+            return pyramid(frm);
+        }));
+    }
+
+    std::vector<Pyramid> pyramids;
+    for (auto &pyr: building)
+        pyramids.push_back(pyr.get());
+
+    std::vector<std::future<Offset>> aligning;
+    for (int k = 0; k < n; k++) {
+        if (k == ref) {
+            aligning.push_back(std::async(std::launch::deferred, []() {
+                return Offset {0, 0};
+            }));
+        }
+        else {
+            aligning.push_back(pool.offload([&, k]() {
+                return align(pyramids[ref], pyramids[k]);
+            }));
+        }
+    }
+
+    std::vector<Offset> offsets;
+    for (auto &off: aligning)
+        offsets.push_back(off.get());
+
+    auto out = av_frame_alloc();
+    out->format = base->format;
+    out->width = base->width;
+    out->height = base->height;
+    if (av_frame_get_buffer(out, 64) < 0) {
+        av_frame_free(&out);
+        return nullptr;
+    }
+    av_frame_copy_props(out, base);
+
+    const auto desc = av_pix_fmt_desc_get(fmt);
+    for (int p = 0; p < av_pix_fmt_count_planes(fmt); p++) {
+        // interleaved chroma carries two components per pixel
+        int comps = 0;
+        for (int c = 0; c < desc->nb_components; c++)
+            comps += desc->comp[c].plane == p;
+
+        const auto log2W = p ? desc->log2_chroma_w : 0, log2H = p ? desc->log2_chroma_h : 0;
+        if (desc->comp[0].depth > 8)
+            stackPlane<uint16_t>(frames, offsets, ref, mode, out, p, comps, log2W, log2H);
+        else
+            stackPlane<uint8_t>(frames, offsets, ref, mode, out, p, comps, log2W, log2H);
+    }
+
+    return out;
+}
+
+FrameStacker::Pyramid FrameStacker::pyramid(const AVFrame *frm)
+{
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(frm->format));
+    const auto &luma = desc->comp[0];
+
+    // full resolution 8 bit luma at the bottom
+    Pyramid pyr(1);
+    auto &bottom = pyr[0];
+    bottom.width = frm->width;
+    bottom.height = frm->height;
+    bottom.data.resize(size_t(frm->width) * frm->height);
+
+    for (int y = 0; y < frm->height; y++) {
+        const auto src = frm->data[0] + ptrdiff_t(frm->linesize[0]) * y + luma.offset;
+        const auto dst = bottom.data.data() + size_t(frm->width) * y;
+
+        if (luma.depth > 8) {
+            const auto shift = luma.shift + luma.depth - 8;
+            const auto s = reinterpret_cast<const uint16_t *>(src);
+            for (int x = 0; x < frm->width; x++)
+                dst[x] = uint8_t(s[x] >> shift);
+        }
+        else {
+            memcpy(dst, src, frm->width);
+        }
+    }
+
+    // halve by 2x2 box filtering
+    while (pyr.back().width / 2 >= coarsestWidth && pyr.back().height / 2 >= 2) {
+        const auto &fine = pyr.back();
+        Level coarse;
+        coarse.width = fine.width / 2;
+        coarse.height = fine.height / 2;
+        coarse.data.resize(size_t(coarse.width) * coarse.height);
+
+        for (int y = 0; y < coarse.height; y++) {
+            const auto r0 = fine.data.data() + size_t(fine.width) * 2 * y;
+            const auto r1 = r0 + fine.width;
+            const auto dst = coarse.data.data() + size_t(coarse.width) * y;
+            for (int x = 0; x < coarse.width; x++)
+                dst[x] = uint8_t((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+        }
+
+        pyr.push_back(std::move(coarse));
+    }
+
+    return pyr;
+}
+
+FrameStacker::Offset FrameStacker::align(const Pyramid &ref, const Pyramid &frm)
+{
+    const int top = int(ref.size()) - 1;
+    Offset est {0, 0};
+
+    // exhaustive on the coarsest level, then one pixel around the doubled estimate
+    for (int lvl = top; lvl >= 0; lvl--) {
+        const int r = lvl == top ? searchRadius : 1;
+        if (lvl != top) {
+            est.dx *= 2;
+            est.dy *= 2;
+        }
+
+        Offset best = est;
+        double least = std::numeric_limits<double>::max();
+        for (int dy = -r; dy <= r; dy++) {
+            for (int dx = -r; dx <= r; dx++) {
+                const auto cost = sad(ref[lvl], frm[lvl], est.dx + dx, est.dy + dy);
+                if (cost < least) {
+                    least = cost;
+                    best = Offset {est.dx + dx, est.dy + dy};
+                }
+            }
+        }
+
+        est = best;
+    }
+
+    return est;
+}
+
+double FrameStacker::sad(const Level &a, const Level &b, int dx, int dy)
+{
+    // mean absolute difference of a(x, y) and b(x + dx, y + dy) where both exist
+    const int x0 = std::max(0, -dx), x1 = std::min(a.width, a.width - dx);
+    const int y0 = std::max(0, -dy), y1 = std::min(a.height, a.height - dy);
+    if (x1 <= x0 || y1 <= y0)
+        return std::numeric_limits<double>::max();
+
+    const int n = x1 - x0;
+    uint64_t sum = 0;
+
+    for (int y = y0; y < y1; y++) {
+        const auto pa = a.data.data() + size_t(a.width) * y + x0;
+        const auto pb = b.data.data() + size_t(b.width) * (y + dy) + x0 + dx;
+
+        int i = 0;
+#if defined(STACKER_SSE2)
+        auto acc = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pa + i)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb + i))));
+        }
+        sum += uint64_t(_mm_cvtsi128_si32(acc)) + uint64_t(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(STACKER_NEON)
+        auto acc = vdupq_n_u32(0);
+        for (; i + 16 <= n; i += 16)
+            acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(pa + i), vld1q_u8(pb + i))));
+        sum += vaddvq_u32(acc);
+#endif
+        for (; i < n; i++)
+            sum += std::abs(pa[i] - pb[i]);
+    }
+
+    return double(sum) / (double(n) * (y1 - y0));
+}
+
+template<typename T>
+void FrameStacker::stackPlane(const std::vector<const AVFrame *> &frames, const std::vector<Offset> &offsets,
+                              int ref, Mode mode, AVFrame *out, int plane, int comps, int log2W, int log2H)
+{
+    const auto base = frames[ref];
+    const int n = frames.size();
+    const int w = -((-base->width) >> log2W), h = -((-base->height) >> log2H);
+    const int samples = w * comps;
+
+    // translation on this plane's grid, in samples and rows
+    std::vector<int> sx(n), sy(n);
+    for (int k = 0; k < n; k++) {
+        sx[k] = int(std::lround(offsets[k].dx / double(1 << log2W))) * comps;
+        sy[k] = int(std::lround(offsets[k].dy / double(1 << log2H)));
+    }
+
+    const auto band = [&](int from, int to) {
+        std::vector<std::vector<T>> shifted(n);
+        const T *rows[maxFrames];
+
+        for (int y = from; y < to; y++) {
+            for (int k = 0; k < n; k++) {
+                const auto srcY = std::clamp(y + sy[k], 0, h - 1);
+                const auto src = reinterpret_cast<const T *>(frames[k]->data[plane] +
+                                                             ptrdiff_t(frames[k]->linesize[plane]) * srcY);
+                if (!sx[k]) {
+                    rows[k] = src;
+                    continue;
+                }
+
+                // shifted copy, replicating edge pixels component by component
+                auto &buf = shifted[k];
+                buf.resize(samples);
+                const auto x0 = std::min(std::max(0, -sx[k]), samples);
+                const auto x1 = std::max(std::min(samples, samples - sx[k]), x0);
+                memcpy(buf.data() + x0, src + x0 + sx[k], (x1 - x0) * sizeof(T));
+                for (int x = 0; x < x0; x++)
+                    buf[x] = src[x % comps];
+                for (int x = x1; x < samples; x++)
+                    buf[x] = src[samples - comps + x % comps];
+
+                rows[k] = buf.data();
+            }
+
+            const auto dst = reinterpret_cast<T *>(out->data[plane] + ptrdiff_t(out->linesize[plane]) * y);
+            if constexpr (sizeof(T) == 1)
+                combine8(rows, n, dst, samples, mode);
+            else
+                combine16(rows, n, dst, samples, mode);
+        }
+    };
+
+    // bands of rows in parallel
+    auto &pool = JobScheduler::shared();
+    const int bands = std::clamp(pool.size(), 1, h);
+    std::vector<std::future<void>> running;
+    for (int b = 1; b < bands; b++) {
+        running.push_back(pool.offload([&band, b, bands, h]() {
+            band(h * b / bands, h * (b + 1) / bands);
+        }));
+    }
+    band(0, h / bands);
+
+    for (auto &run: running)
+        run.wait();
+}
+
+void FrameStacker::combine8(const uint8_t *const rows[], int n, uint8_t *dst, int count, Mode mode)
+{
+    const float inv = 1.0f / n;
+    int i = 0;
+
+#if defined(STACKER_SSE2)
+    if (mode == Mode::Median) {
+        __m128i v[maxFrames];
+        for (; i + 16 <= count; i += 16) {
+            for (int k = 0; k < n; k++)
+                v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+
+            // bubble the smallest to the front until the middle is in place
+            for (int p = 0; p <= n / 2; p++) {
+                for (int j = n - 1; j > p; j--) {
+                    const auto lo = _mm_min_epu8(v[j - 1], v[j]);
+                    v[j] = _mm_max_epu8(v[j - 1], v[j]);
+                    v[j - 1] = lo;
+                }
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v[n / 2]);
+        }
+    }
+    else {
+        const auto zero = _mm_setzero_si128();
+        const auto scale = _mm_set1_ps(inv), half = _mm_set1_ps(0.5f);
+        const auto divide = [&](__m128i sum32) {
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum32), scale), half));
+        };
+
+        for (; i + 16 <= count; i += 16) {
+            auto lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+            for (int k = 0; k < n; k++) {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+            }
+
+            const auto rlo = _mm_packs_epi32(divide(_mm_unpacklo_epi16(lo, zero)), divide(_mm_unpackhi_epi16(lo, zero)));
+            const auto rhi = _mm_packs_epi32(divide(_mm_unpacklo_epi16(hi, zero)), divide(_mm_unpackhi_epi16(hi, zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(rlo, rhi));
+        }
+    }
+#elif defined(STACKER_NEON)
+    if (mode == Mode::Median) {
+        uint8x16_t v[maxFrames];
+        for (; i + 16 <= count; i += 16) {
+            for (int k = 0; k < n; k++)
+                v[k] = vld1q_u8(rows[k] + i);
+
+            for (int p = 0; p <= n / 2; p++) {
+                for (int j = n - 1; j > p; j--) {
+                    const auto lo = vminq_u8(v[j - 1], v[j]);
+                    v[j] = vmaxq_u8(v[j - 1], v[j]);
+                    v[j - 1] = lo;
+                }
+            }
+            vst1q_u8(dst + i, v[n / 2]);
+        }
+    }
+    else {
+        const auto divide = [&](uint32x4_t sum32) {
+            return vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(sum32), inv), vdupq_n_f32(0.5f)));
+        };
+
+        for (; i + 16 <= count; i += 16) {
+            auto lo = vdupq_n_u16(0), hi = vdupq_n_u16(0);
+            for (int k = 0; k < n; k++) {
+                const auto v = vld1q_u8(rows[k] + i);
+                lo = vaddw_u8(lo, vget_low_u8(v));
+                hi = vaddw_u8(hi, vget_high_u8(v));
+            }
+
+            const auto rlo = vcombine_u16(vmovn_u32(divide(vmovl_u16(vget_low_u16(lo)))),
+                                          vmovn_u32(divide(vmovl_u16(vget_high_u16(lo)))));
+            const auto rhi = vcombine_u16(vmovn_u32(divide(vmovl_u16(vget_low_u16(hi)))),
+                                          vmovn_u32(divide(vmovl_u16(vget_high_u16(hi)))));
+            vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(rlo), vqmovn_u16(rhi)));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (mode == Mode::Median) {
+            uint8_t v[maxFrames];
+            for (int k = 0; k < n; k++)
+                v[k] = rows[k][i];
+            std::nth_element(v, v + n / 2, v + n);
+            dst[i] = v[n / 2];
+        }
+        else {
+            int sum = 0;
+            for (int k = 0; k < n; k++)
+                sum += rows[k][i];
+            dst[i] = uint8_t(float(sum) * inv + 0.5f);
+        }
+    }
+}
+
+void FrameStacker::combine16(const uint16_t *const rows[], int n, uint16_t *dst, int count, Mode mode)
+{
+    const float inv = 1.0f / n;
+    int i = 0;
+
+#if defined(STACKER_SSE2)
+    // unsigned order and range by way of flipping the sign bit for signed SSE2 operations
+    const auto sign = _mm_set1_epi16(-32768);
+
+    if (mode == Mode::Median) {
+        __m128i v[maxFrames];
+        for (; i + 8 <= count; i += 8) {
+            for (int k = 0; k < n; k++)
+                v[k] = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i)), sign);
+
+            for (int p = 0; p <= n / 2; p++) {
+                for (int j = n - 1; j > p; j--) {
+                    const auto lo = _mm_min_epi16(v[j - 1], v[j]);
+                    v[j] = _mm_max_epi16(v[j - 1], v[j]);
+                    v[j - 1] = lo;
+                }
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(v[n / 2], sign));
+        }
+    }
+    else {
+        const auto zero = _mm_setzero_si128();
+        const auto scale = _mm_set1_ps(inv), half = _mm_set1_ps(0.5f);
+        const auto bias = _mm_set1_epi32(32768);
+        const auto divide = [&](__m128i sum32) {
+            const auto q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum32), scale), half));
+            return _mm_sub_epi32(q, bias);
+        };
+
+        for (; i + 8 <= count; i += 8) {
+            auto lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+            for (int k = 0; k < n; k++) {
+                const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+                lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+                hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+            }
+
+            const auto packed = _mm_packs_epi32(divide(lo), divide(hi));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(packed, sign));
+        }
+    }
+#elif defined(STACKER_NEON)
+    if (mode == Mode::Median) {
+        uint16x8_t v[maxFrames];
+        for (; i + 8 <= count; i += 8) {
+            for (int k = 0; k < n; k++)
+                v[k] = vld1q_u16(rows[k] + i);
+
+            for (int p = 0; p <= n / 2; p++) {
+                for (int j = n - 1; j > p; j--) {
+                    const auto lo = vminq_u16(v[j - 1], v[j]);
+                    v[j] = vmaxq_u16(v[j - 1], v[j]);
+                    v[j - 1] = lo;
+                }
+            }
+            vst1q_u16(dst + i, v[n / 2]);
+        }
+    }
+    else {
+        const auto divide = [&](uint32x4_t sum32) {
+            return vcvtq_u32_f32(vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(sum32), inv), vdupq_n_f32(0.5f)));
+        };
+
+        for (; i + 8 <= count; i += 8) {
+            auto lo = vdupq_n_u32(0), hi = vdupq_n_u32(0);
+            for (int k = 0; k < n; k++) {
+                const auto v = vld1q_u16(rows[k] + i);
+                lo = vaddw_u16(lo, vget_low_u16(v));
+                hi = vaddw_u16(hi, vget_high_u16(v));
+            }
+
+            vst1q_u16(dst + i, vcombine_u16(vqmovn_u32(divide(lo)), vqmovn_u32(divide(hi))));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (mode == Mode::Median) {
+            uint16_t v[maxFrames];
+            for (int k = 0; k < n; k++)
+                v[k] = rows[k][i];
+            std::nth_element(v, v + n / 2, v + n);
+            dst[i] = v[n / 2];
+        }
+        else {
+            int64_t sum = 0;
+            for (int k = 0; k < n; k++)
+                sum += rows[k][i];
+            dst[i] = uint16_t(float(sum) * inv + 0.5f);
+        }
+    }
+}
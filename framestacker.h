@@ -0,0 +1,52 @@
+#ifndef FRAMESTACKER_H
+#define FRAMESTACKER_H
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// merges aligned neighbouring frames into one with less noise
+class FrameStacker
+{
+public:
+    enum class Mode {
+        Mean,
+        Median
+    };
+
+    static constexpr int maxFrames = 15;
+
+    // new frame in the format of frames[ref] aligned to it, nullptr if the format is unsupported
+    static AVFrame *stack(const std::vector<const AVFrame *> &frames, int ref, Mode mode);
+
+protected:
+    // pyramid levels get no smaller than this
+    static constexpr int coarsestWidth = 160;
+    // translation searched on the coarsest level, refined by one pixel on every finer one
+    static constexpr int searchRadius = 4;
+
+    struct Offset {
+        int dx, dy;
+    };
+
+    struct Level {
+        std::vector<uint8_t> data;
+        int width, height;
+    };
+    using Pyramid = std::vector<Level>;
+
+    static Pyramid pyramid(const AVFrame *frm);
+    static Offset align(const Pyramid &ref, const Pyramid &frm);
+    static double sad(const Level &a, const Level &b, int dx, int dy);
+
+    template<typename T>
+    static void stackPlane(const std::vector<const AVFrame *> &frames, const std::vector<Offset> &offsets,
+                           int ref, Mode mode, AVFrame *out, int plane, int comps, int log2W, int log2H);
+    static void combine8(const uint8_t *const rows[], int n, uint8_t *dst, int count, Mode mode);
+    static void combine16(const uint16_t *const rows[], int n, uint16_t *dst, int count, Mode mode);
+};
+
+#endif // FRAMESTACKER_H
@@ -0,0 +1,121 @@
+#include "frameview.h"
+
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRegion>
+#include <QRubberBand>
+#include <algorithm>
+
+FrameView::FrameView(QWidget *parent) : QWidget(parent), band(nullptr), lastPaintMs(0), fresh(false)
+{
+    // every exposed pixel is painted, by the image or the background
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    clock.start();
+}
+
+void FrameView::setImage(const QImage &img)
+{
+    // what either image covers, usually the same rectangle
+    QRegion dirty(image.rect());
+    image = img;
+    dirty += image.rect();
+
+    fresh = true;
+    update(dirty);
+}
+
+void FrameView::clear()
+{
+    setImage(QImage());
+    fresh = false;
+}
+
+void FrameView::setSelection(const QRectF &area)
+{
+    QRegion dirty(selectionRect());
+    selection = area;
+    dirty += selectionRect();
+
+    update(dirty);
+}
+
+double FrameView::framesPerSecond() const
+{
+    const auto since = clock.elapsed() - rateWindowMs;
+    const auto recent = std::count_if(shownAt.begin(), shownAt.end(), [since](qint64 at) {
+        return at > since;
+    });
+
+    return recent * 1000.0 / rateWindowMs;
+}
+
+void FrameView::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer paintClock;
+    paintClock.start();
+
+    QPainter painter(this);
+
+    // the image 1:1 where exposed, the background around it
+    const auto area = event->rect().intersected(image.rect());
+    if (!area.isEmpty())
+        painter.drawImage(area.topLeft(), image, area);
+
+    for (const auto &rect: event->region().subtracted(image.rect()))
+        painter.fillRect(rect, palette().window());
+
+    if (!selection.isEmpty()) {
+        painter.setPen(QPen(Qt::yellow, 0, Qt::DashLine));
+        painter.drawRect(selection);
+    }
+
+    if (fresh) {
+        fresh = false;
+        shownAt.push_back(clock.elapsed());
+        while (shownAt.front() <= shownAt.back() - rateWindowMs)
+            shownAt.pop_front();
+
+        lastPaintMs = paintClock.nsecsElapsed() / 1e6;
+    }
+}
+
+void FrameView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    if (!band)
+        band = new QRubberBand(QRubberBand::Rectangle, this);
+
+    dragStart = event->pos();
+    band->setGeometry(QRect(dragStart, QSize()));
+    band->show();
+}
+
+void FrameView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (band && band->isVisible())
+        band->setGeometry(QRect(dragStart, event->pos()).normalized());
+}
+
+void FrameView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!band || !band->isVisible())
+        return;
+
+    band->hide();
+
+    // a click without dragging keeps the selection
+    const auto area = QRectF(dragStart, event->pos()).normalized();
+    if (area.width() > 1 && area.height() > 1)
+        emit areaSelected(area);
+}
+
+QRect FrameView::selectionRect() const
+{
+    // the outline is drawn on the edge of the area
+    return selection.isEmpty() ? QRect() : selection.toAlignedRect().adjusted(-1, -1, 1, 1);
+}
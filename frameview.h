@@ -0,0 +1,56 @@
+#ifndef FRAMEVIEW_H
+#define FRAMEVIEW_H
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPoint>
+#include <QRectF>
+#include <QWidget>
+#include <deque>
+
+class QRubberBand;
+
+// shows presented frames at the top left, painting just the image that changed with a single blit, and lets an
+// area be selected by dragging. The image is kept by reference so the producer can convert into it again once
+// the next one arrived.
+class FrameView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit FrameView(QWidget *parent = nullptr);
+
+    void setImage(const QImage &img);
+    void clear();
+    // area to outline, in image coordinates
+    void setSelection(const QRectF &area);
+
+    // images shown per second over the last second, and what painting the last one took
+    double framesPerSecond() const;
+    double paintMs() const {return lastPaintMs;};
+
+signals:
+    // a drag ended
+    void areaSelected(QRectF area);
+
+protected:
+    // frames counted towards framesPerSecond()
+    static constexpr int rateWindowMs = 1000;
+
+    QImage image;
+    QRectF selection;
+    QRubberBand *band;
+    QPoint dragStart;
+
+    QElapsedTimer clock;
+    std::deque<qint64> shownAt;
+    double lastPaintMs;
+    bool fresh; // an image not painted yet
+
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    QRect selectionRect() const;
+};
+
+#endif // FRAMEVIEW_H
@@ -5,6 +5,7 @@
 #include <QtEndian>
 #include <memory>
 #include <QDateTime>
+#include "tracer.h"
 
 GoproReader::GoproReader(uint32_t timeStamp, ExifData *exifData) :
      begin(GPMF_stream()), timeStamp(timeStamp), exifData(exifData)
@@ -187,6 +188,8 @@ void GoproReader::handleDeviceName()
 
 void GoproReader::extract(QByteArray &data)
 {
+    Tracer::Span span("GoproReader::extract");
+
     if (GPMF_Init(&begin, reinterpret_cast<uint32_t *>(data.data()), data.size()) != GPMF_OK)
         return;
 
@@ -1,13 +1,47 @@
 #include "heifwriter.h"
 #include "scopedresource.h"
+#include "threadbudget.h"
+#include "tracer.h"
 
 #include <QDebug>
 #include <QFile>
 #include <QStandardPaths>
 #include <libheif/heif.h>
 
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 bool HeifWriter::save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
-                      ColorParams &colr, ExifData &exifData)
+                      ColorParams &colr, ExifData &exifData, const QRect &crop)
+{
+    // encode only the selected area, straight from the decoded planes
+    const auto view = cropped(frm, crop);
+    if (!view)
+        return false;
+
+    return write({view.get()}, fileName, metaDataReady, iccFileName, colr, {&exifData});
+}
+
+bool HeifWriter::saveBurst(const std::vector<AVFrame *> &frames, QString fileName, std::future<void> &metaDataReady,
+                           QString &iccFileName, ColorParams &colr, std::vector<ExifData> &exifData)
+{
+    if (frames.empty() || frames.size() != exifData.size()) {
+        qCritical() << "burst needs Exif data per frame";
+        return false;
+    }
+
+    std::vector<const AVFrame *> frms(frames.begin(), frames.end());
+    std::vector<const ExifData *> exif;
+    for (const auto &data: exifData)
+        exif.push_back(&data);
+
+    return write(frms, fileName, metaDataReady, iccFileName, colr, exif);
+}
+
+bool HeifWriter::write(const std::vector<const AVFrame *> &frames, QString fileName,
+                       std::future<void> &metaDataReady, QString &iccFileName, ColorParams &colr,
+                       const std::vector<const ExifData *> &exif)
 {
     ScopedResource<heif_context, int> hCtx(
         [](heif_context *&ctx, int &){
@@ -44,115 +78,156 @@ bool HeifWriter::save(AVFrame *frm, QString fileName, std::future<void> &metaDat
         }
     }
 
-    // prepare color settings
-    heif_colorspace cs;
-    heif_chroma chroma;
-    heif_channel channels[3];
-    int widths[3], heights[3], depths[3];
-    int n_channels;
-    setHeifColor(frm, cs, chroma, n_channels, channels, depths, widths, heights);
+    // x265 sizes its pool to the machine otherwise; other encoders do not know the parameter
+    const auto pools = QByteArray::number(ThreadBudget::encoder());
+    heif_encoder_set_parameter(enc, "x265:pools", pools.constData());
 
+    // color profiles, identical for every item so libheif stores the properties once
     std::unique_ptr<heif_color_profile_nclx> cp(new heif_color_profile_nclx);
-    setColorProfile(cp.get(), colr);
+    QByteArray icc;
+    bool profiled = false;
 
-    // image
-    ScopedResource<heif_image, heif_error> img(
-        [&] (heif_image *&img, heif_error &err) {
-            err = heif_image_create(frm->width, frm->height, cs, chroma, &img);
-        },
-        [] (heif_image *img, const heif_error &err) {
-            if (err.code != heif_error_Ok)
-                heif_image_release(img);
+    for (size_t n = 0; n < frames.size(); n++) {
+        const auto frm = frames[n];
+
+        // prepare color settings
+        const auto kern = pixelKernels(AVPixelFormat(frm->format));
+        heif_colorspace cs;
+        heif_chroma chroma;
+        heif_channel channels[3];
+        int widths[3], heights[3], depths[3];
+        int n_channels;
+        setHeifColor(frm, kern, cs, chroma, n_channels, channels, depths, widths, heights);
+        if (!n_channels)
+            return false;
+
+        // image
+        ScopedResource<heif_image, heif_error> img(
+            [&] (heif_image *&img, heif_error &err) {
+                err = heif_image_create(frm->width, frm->height, cs, chroma, &img);
+            },
+            [] (heif_image *img, const heif_error &err) {
+                if (err.code == heif_error_Ok)
+                    heif_image_release(img);
+            }
+        );
+        if (img.error().code != heif_error_Ok) {
+            qCritical() << "cannot create image:" << img.error().message;
+            return false;
         }
-    );
 
-    for (int i = 0; i < n_channels; i++) {
-        int stride;
-        heif_image_add_plane(img.get(), channels[i], widths[i], heights[i], depths[i]);
-        auto planeData = heif_image_get_plane(img.get(), channels[i], &stride);
-        for (int h = 0; h < heights[i]; h++) {
-            memcpy(planeData + (stride * h), frm->data[i] + (frm->linesize[i] * h),
-                   stride);
+        PlaneTarget planes[3];
+        for (int i = 0; i < n_channels; i++) {
+            err = heif_image_add_plane(img.get(), channels[i], widths[i], heights[i], depths[i]);
+            if (err.code != heif_error_Ok) {
+                qCritical() << "cannot add image plane:" << err.message;
+                return false;
+            }
+
+            int stride;
+            planes[i].data = heif_image_get_plane(img.get(), channels[i], &stride);
+            planes[i].stride = stride;
         }
-    }
 
-    // encode
-    ScopedResource<heif_image_handle, heif_error> imgH(
-        [&](heif_image_handle *&imgH, heif_error &err) {
-            err = heif_context_encode_image(hCtx.get(), img.get(), encPtr.get(), nullptr, &imgH);
-        },
-        [](heif_image_handle *imgH, const heif_error &err) {
-            if (err.code != heif_error_Ok)
-                heif_image_handle_release(imgH);
-        });
-    if (imgH.error().code != heif_error_Ok) {
-        qCritical() << "encoder error:" << imgH.error().message;
-        return false;
-    }
+        kern->copy(frm, planes);
 
-    metaDataReady.wait();
+        // profiles are attached when encoding, so they need the metadata by now
+        if (!profiled) {
+            metaDataReady.wait();
+            setColorProfile(cp.get(), colr);
 
-    auto perr = heif_image_set_nclx_color_profile(img.get(), cp.get());
-    if (perr.code != heif_error_Ok) {
-        qCritical() << "setting color profile failed:" << perr.message;
-        return false;
-    }
+            if (!iccFileName.isEmpty()) {
+                qDebug() << "embedding color profile" << iccFileName;
 
-    if (!iccFileName.isEmpty()) {
-        qDebug() << "embedding color profile" << iccFileName;
+                QFile iccFile(iccFileName);
+                iccFile.open(QIODevice::ReadOnly);
+                icc = iccFile.readAll();
+            }
+            else
+                qWarning() << "no color profile embedded for trc" << frm->color_trc;
 
-        QFile iccFile(iccFileName);
-        iccFile.open(QIODevice::ReadOnly);
-        auto icc = iccFile.readAll();
-        heif_image_set_raw_color_profile(img.get(), "prof", icc.constData(), icc.size());
-    }
-    else
-        qWarning() << "no color profile embedded for trc" << frm->color_trc;
+            profiled = true;
+        }
+
+        auto perr = heif_image_set_nclx_color_profile(img.get(), cp.get());
+        if (perr.code != heif_error_Ok) {
+            qCritical() << "setting color profile failed:" << perr.message;
+            return false;
+        }
+        if (!icc.isEmpty())
+            heif_image_set_raw_color_profile(img.get(), "prof", icc.constData(), icc.size());
 
-    perr = addMeta(hCtx.get(), imgH.get(), exifData);
-    Q_ASSERT_X(perr.code == 0, "", perr.message);
+        // encode, the first image becomes the primary one
+        ScopedResource<heif_image_handle, heif_error> imgH(
+            [&](heif_image_handle *&imgH, heif_error &err) {
+                Tracer::Span span("heif encode");
+                err = heif_context_encode_image(hCtx.get(), img.get(), encPtr.get(), nullptr, &imgH);
+            },
+            [](heif_image_handle *imgH, const heif_error &err) {
+                if (err.code == heif_error_Ok)
+                    heif_image_handle_release(imgH);
+            });
+        if (imgH.error().code != heif_error_Ok) {
+            qCritical() << "encoder error:" << imgH.error().message;
+            return false;
+        }
+
+        perr = addMeta(hCtx.get(), imgH.get(), *exif[n]);
+        Q_ASSERT_X(perr.code == 0, "", perr.message);
+    }
 
     // write HEIC
-    err = heif_context_write_to_file(hCtx.get(), fileName.toLocal8Bit().constData());
+    {
+        Tracer::Span span("heif write");
+        if (buffer) {
+            heif_writer writer;
+            writer.writer_api_version = 1;
+            writer.write = [](heif_context *, const void *data, size_t size, void *userdata) {
+                static_cast<QByteArray *>(userdata)->append(static_cast<const char *>(data), int(size));
+                return heif_error {heif_error_Ok, heif_suberror_Unspecified, "Success"};
+            };
+            err = heif_context_write(hCtx.get(), &writer, buffer);
+        }
+        else {
+            err = heif_context_write_to_file(hCtx.get(), fileName.toLocal8Bit().constData());
+        }
+    }
     if (err.code != heif_error_Ok) {
         qCritical() << "error writing image:" << err.message;
         return false;
     }
-    else {
+    else if (!buffer) {
         qInfo() << "written to: " << fileName;
     }
 
     return true;
 }
 
-void HeifWriter::setHeifColor(AVFrame *frm, heif_colorspace &space, heif_chroma &chroma, int &n_channels,
-                              heif_channel channels[], int depths[], int widths[], int heights[])
+void HeifWriter::setHeifColor(const AVFrame *frm, const PixelKernels *kern, heif_colorspace &space, heif_chroma &chroma,
+                              int &n_channels, heif_channel channels[], int depths[], int widths[], int heights[])
 {
-    switch(frm->format) {
-        case AV_PIX_FMT_YUVJ420P:
-        case AV_PIX_FMT_YUV420P:
-            n_channels = 3;
-            space = heif_colorspace_YCbCr;
-            chroma = heif_chroma_420;
-            channels[0] = heif_channel_Y;
-            depths[0] = 8;
-            widths[0] = frm->width;
-            heights[0] = frm->height;
-            channels[1] = heif_channel_Cb;
-            depths[1] = 8;
-            widths[1] = (frm->width + 1) / 2;
-            heights[1] = (frm->height + 1) / 2;
-            channels[2] = heif_channel_Cr;
-            depths[2] = depths[1];
-            widths[2] = widths[1];
-            heights[2] = heights[1];
-            break;
-        default:
-            qCritical() << "unexpected pixel format" << frm->format;
-            n_channels = 0;
-            space = heif_colorspace_undefined;
-            chroma = heif_chroma_undefined;
-            break;
+    if (!kern) {
+        qCritical() << "unexpected pixel format" << av_get_pix_fmt_name(AVPixelFormat(frm->format));
+        n_channels = 0;
+        space = heif_colorspace_undefined;
+        chroma = heif_chroma_undefined;
+        return;
+    }
+
+    if (kern->log2ChromaW)
+        chroma = kern->log2ChromaH ? heif_chroma_420 : heif_chroma_422;
+    else
+        chroma = heif_chroma_444;
+
+    const heif_channel yuv[] = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+
+    n_channels = 3;
+    space = heif_colorspace_YCbCr;
+    for (int i = 0; i < n_channels; i++) {
+        channels[i] = yuv[i];
+        depths[i] = kern->depth;
+        widths[i] = kern->planeWidth(i, frm->width);
+        heights[i] = kern->planeHeight(i, frm->height);
     }
 }
 
@@ -178,22 +253,11 @@ void HeifWriter::setColorProfile(heif_color_profile_nclx *cp, ColorParams &color
     else
         cp->color_primaries = prim[0];
 
-    // transfer function
-    switch (color.transfer)
-    {
-        case 1:
-            cp->transfer_characteristics = heif_transfer_characteristic_ITU_R_BT_709_5;
-            break;
-        case 7:
-            cp->transfer_characteristics = heif_transfer_characteristic_SMPTE_240M;
-            break;
-        case 17:
-            cp->transfer_characteristics = heif_transfer_characteristic_SMPTE_ST_428_1;
-            break;
-        default:
-            cp->transfer_characteristics = heif_transfer_characteristic_unspecified;
-            break;
-    }
+    // transfer function, libheif uses the H.273 codes as they come from the stream, PQ (16) and HLG (18) included
+    if (color.transfer >= 1 && color.transfer <= 18 && color.transfer != 2 && color.transfer != 3)
+        cp->transfer_characteristics = static_cast<heif_transfer_characteristics>(color.transfer);
+    else
+        cp->transfer_characteristics = heif_transfer_characteristic_unspecified;
 
     // matrix
     switch (color.matrix)
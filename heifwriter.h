@@ -1,7 +1,9 @@
 #ifndef HEIFWRITER_H
 #define HEIFWRITER_H
 
+#include <vector>
 #include "filewriter.h"
+#include "pixelkernels.h"
 extern "C" {
 #include <libheif/heif.h>
 }
@@ -10,11 +12,16 @@ class HeifWriter : public FileWriter
 {
 public:
     bool save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
-              ColorParams &colr, ExifData &exifData);
+              ColorParams &colr, ExifData &exifData, const QRect &crop = QRect());
+    // frames as items of one file sharing encoder and colour profile, one Exif block each
+    bool saveBurst(const std::vector<AVFrame *> &frames, QString fileName, std::future<void> &metaDataReady,
+                   QString &iccFileName, ColorParams &colr, std::vector<ExifData> &exifData);
 
 protected:
-    void setHeifColor(AVFrame *frm, heif_colorspace &space, heif_chroma &chroma, int &n_channels,
-                      heif_channel channels[], int depths[], int widths[], int heights[]);
+    bool write(const std::vector<const AVFrame *> &frames, QString fileName, std::future<void> &metaDataReady,
+               QString &iccFileName, ColorParams &colr, const std::vector<const ExifData *> &exif);
+    void setHeifColor(const AVFrame *frm, const PixelKernels *kern, heif_colorspace &space, heif_chroma &chroma,
+                      int &n_channels, heif_channel channels[], int depths[], int widths[], int heights[]);
     void setColorProfile(heif_color_profile_nclx *cp, ColorParams &colorParams);
     heif_error addMeta(heif_context *ctx, heif_image_handle *hndl, const ExifData &exif);
 };
@@ -0,0 +1,157 @@
+#include "jobscheduler.h"
+
+#include <algorithm>
+#include "threadbudget.h"
+
+namespace {
+
+// the scheduler and queue a worker thread belongs to
+thread_local const JobScheduler *owner = nullptr;
+thread_local size_t ownIndex = 0;
+
+}
+
+JobScheduler::JobScheduler(int threads) : next(0), stop(false)
+{
+    for (int l = 0; l < levels; l++) {
+        unclaimed[l] = 0;
+        running[l] = limit[l] = 0;
+    }
+
+    const auto count = size_t(std::max(threads, 1));
+    for (size_t i = 0; i < count; i++)
+        queues.emplace_back(new Queue);
+
+    for (size_t i = 0; i < count; i++)
+        workers.emplace_back(&JobScheduler::work, this, i);
+}
+
+JobScheduler::~JobScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cond.notify_all();
+
+    for (auto &worker: workers)
+        worker.join();
+}
+
+JobScheduler &JobScheduler::shared()
+{
+    static JobScheduler pool(ThreadBudget::pool());
+    static std::once_flag capped;
+    std::call_once(capped, []() {
+        pool.setLimit(Priority::Save, ThreadBudget::saves());
+        pool.setLimit(Priority::Background, ThreadBudget::background());
+    });
+
+    return pool;
+}
+
+void JobScheduler::setLimit(Priority priority, int running)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        limit[int(priority)] = running;
+    }
+    cond.notify_all();
+}
+
+void JobScheduler::post(std::function<void()> task, Priority priority)
+{
+    const auto level = int(priority);
+    const auto index = owner == this ? ownIndex : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mtx);
+        queues[index]->tasks[level].push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        unclaimed[level]++;
+    }
+    cond.notify_one();
+}
+
+int JobScheduler::claim() const
+{
+    // the most urgent level with queued tasks and room to run them, called with mtx held
+    for (int l = 0; l < levels; l++) {
+        if (unclaimed[l] && (limit[l] <= 0 || running[l] < limit[l]))
+            return l;
+    }
+
+    return -1;
+}
+
+void JobScheduler::work(size_t index)
+{
+    owner = this;
+    ownIndex = index;
+
+    while (true) {
+        int level;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cond.wait(lock, [this, &level]() {
+                level = claim();
+                return level >= 0 || stop;
+            });
+            if (level < 0) {
+                // capped levels still hold tasks: their running ones finish and wake us
+                bool queued = false;
+                for (int l = 0; l < levels; l++)
+                    queued = queued || unclaimed[l];
+                if (!queued)
+                    return;
+
+                cond.wait(lock);
+                continue;
+            }
+
+            unclaimed[level]--;
+            running[level]++;
+        }
+
+        // a claim is backed by a queued task, though another worker may have taken it from this queue
+        take(index, level)();
+
+        bool capped;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            running[level]--;
+            capped = limit[level] > 0;
+        }
+        if (capped)
+            cond.notify_all();
+    }
+}
+
+std::function<void()> JobScheduler::take(size_t index, int level)
+{
+    while (true) {
+        {
+            auto &own = queues[index]->tasks[level];
+            std::lock_guard<std::mutex> lock(queues[index]->mtx);
+            if (!own.empty()) {
+                auto task = std::move(own.front());
+                own.pop_front();
+                return task;
+            }
+        }
+
+        for (size_t i = 1; i < queues.size(); i++) {
+            auto &other = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(other.mtx);
+            if (!other.tasks[level].empty()) {
+                auto task = std::move(other.tasks[level].back());
+                other.tasks[level].pop_back();
+                return task;
+            }
+        }
+
+        std::this_thread::yield();
+    }
+}
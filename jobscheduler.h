@@ -0,0 +1,110 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool with priorities: every worker runs its own queue in order and takes from the back of
+// the others once it runs dry, always the most urgent task first. Levels can be capped to a number of tasks
+// running at once, so long saves leave workers for what the user waits on.
+class JobScheduler
+{
+public:
+    enum class Priority {
+        Interactive, // the user waits for it
+        Display,     // frames about to be shown
+        Save,
+        Background
+    };
+
+    explicit JobScheduler(int threads);
+    JobScheduler(const JobScheduler &) = delete;
+    // runs what is queued, then joins the workers
+    ~JobScheduler();
+
+    // the process-wide pool, sized and capped by ThreadBudget
+    static JobScheduler &shared();
+
+    int size() const {return int(workers.size());};
+    // tasks of a level running at once, unlimited if not positive
+    void setLimit(Priority priority, int running);
+
+    // queued on the calling worker's own queue, or spread over the queues from other threads.
+    // Tasks must not wait for other tasks of the pool; use offload() for work they wait on.
+    void post(std::function<void()> task, Priority priority = Priority::Save);
+
+    template<class F>
+    auto submit(F fn, Priority priority = Priority::Save) -> std::future<decltype(fn())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::move(fn));
+        auto result = task->get_future();
+        post([task]() {
+            (*task)();
+        }, priority);
+
+        return result;
+    }
+
+    // like submit(), but waiting for the result runs fn in the waiting thread if no worker started it yet,
+    // so tasks may wait for it. The future is deferred: wait_for() does not tell whether it is done.
+    template<class F>
+    auto offload(F fn, Priority priority = Priority::Save) -> std::future<decltype(fn())>
+    {
+        using Result = decltype(fn());
+        struct Claimed {
+            std::packaged_task<Result()> task;
+            std::future<Result> result;
+            std::atomic<bool> taken {false};
+
+            void run()
+            {
+                if (!taken.exchange(true))
+                    task();
+            }
+        };
+
+        auto job = std::make_shared<Claimed>();
+        job->task = std::packaged_task<Result()>(std::move(fn));
+        job->result = job->task.get_future();
+        post([job]() {
+            job->run();
+        }, priority);
+
+        return std::async(std::launch::deferred, [job]() {
+            job->run();
+            return job->result.get();
+        });
+    }
+
+protected:
+    static constexpr int levels = 4;
+
+    struct Queue {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks[levels];
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next;
+
+    // per level: tasks queued but not yet claimed by a worker, tasks running, and the cap on those
+    std::mutex mtx;
+    std::condition_variable cond;
+    size_t unclaimed[levels];
+    int running[levels], limit[levels];
+    bool stop;
+
+    void work(size_t index);
+    int claim() const;
+    std::function<void()> take(size_t index, int level);
+};
+
+#endif // JOBSCHEDULER_H
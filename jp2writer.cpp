@@ -3,42 +3,43 @@
 #include <QDebug>
 #include <QFile>
 #include <vector>
-#include <execution>
 #include "scopedresource.h"
+#include "pixelkernels.h"
+#include "threadbudget.h"
 #include <openjpeg.h>
 
 bool Jp2Writer::save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
-                     ColorParams &colr, ExifData &exifData)
+                     ColorParams &colr, ExifData &exifData, const QRect &crop)
 {
+    const auto view = cropped(frm, crop);
+    if (!view)
+        return false;
+    frm = view.get();
+
     std::vector<opj_image_cmptparm_t> cmptparm;
     opj_cparameters_t encParams;
     OPJ_COLOR_SPACE cSpace;
-    int compts;
 
-    if (frm->format == AV_PIX_FMT_YUVJ420P || frm->format == AV_PIX_FMT_YUV420P) {
+    const auto kern = pixelKernels(AVPixelFormat(frm->format));
+    if (!kern) {
+        qCritical() << "unsupported frame format" << frm->format;
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
         opj_image_cmptparm_t comp {
-            .dx = 0, .dy = 0,
-            .w = OPJ_UINT32(frm->width), .h = OPJ_UINT32(frm->height),
+            .dx = OPJ_UINT32(i ? 1 << kern->log2ChromaW : 1), .dy = OPJ_UINT32(i ? 1 << kern->log2ChromaH : 1),
+            .w = OPJ_UINT32(kern->planeWidth(i, frm->width)), .h = OPJ_UINT32(kern->planeHeight(i, frm->height)),
             .x0 = 0, .y0 = 0,
-            .prec = 8,
-            .bpp = 8,
+            .prec = OPJ_UINT32(kern->depth),
+            .bpp = OPJ_UINT32(kern->depth),
             .sgnd = 0
         };
-        cmptparm.push_back(comp); // Y
-
-        comp.w = frm->linesize[1];
-        comp.h = (frm->height + 1) / 2;
-        cmptparm.push_back(comp); // Cb
-        cmptparm.push_back(comp); // Cr
-
-        cSpace = OPJ_CLRSPC_SYCC;
-        compts = 3;
-    }
-    else {
-        qCritical() << "unsupported frame format" << frm->format;
-        return false;
+        cmptparm.push_back(comp); // Y, Cb, Cr
     }
 
+    cSpace = OPJ_CLRSPC_SYCC;
+
     ScopedResource<opj_image, bool> img(
         [&] (opj_image *&img, bool &err) {
             img = opj_image_create(cmptparm.size(), cmptparm.data(), cSpace);
@@ -78,7 +79,7 @@ bool Jp2Writer::save(AVFrame *frm, QString fileName, std::future<void> &metaData
         qCritical() << "error setting up JP2 encoder";
         return false;
     }
-    opj_codec_set_threads(codec.get(), opj_get_num_cpus());
+    opj_codec_set_threads(codec.get(), ThreadBudget::encoder());
 
     {
         ScopedResource<opj_stream_t, bool> strm(
@@ -95,10 +96,12 @@ bool Jp2Writer::save(AVFrame *frm, QString fileName, std::future<void> &metaData
             return false;
         }
 
-        for (int i = 0; i < compts; i++) {
-            std::copy(std::execution::par_unseq,
-                      frm->data[i], frm->data[i] + frm->linesize[i] * jp2->comps[i].h + 1, jp2->comps[i].data);
+        PlaneTarget planes[3];
+        for (int i = 0; i < 3; i++) {
+            planes[i].data = reinterpret_cast<uint8_t *>(jp2->comps[i].data);
+            planes[i].stride = ptrdiff_t(jp2->comps[i].w) * sizeof(OPJ_INT32);
         }
+        kern->widen(frm, planes);
 
         if (!opj_start_compress(codec.get(), jp2, strm.get()) ||
                 !opj_encode(codec.get(), strm.get()) ||
@@ -7,7 +7,7 @@ class Jp2Writer : public FileWriter
 {
 public:
     virtual bool save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
-                      ColorParams &colr, ExifData &exifData);
+                      ColorParams &colr, ExifData &exifData, const QRect &crop = QRect());
 };
 
 #endif // JP2WRITER_H
@@ -1,9 +1,190 @@
 #include "mainwindow.h"
+#include "batchrunner.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QStandardPaths>
+#include <cstring>
+#include <thread>
+#ifdef Q_OS_UNIX
+#include "frameserver.h"
+#endif
+#include "threadbudget.h"
+#include "tracer.h"
+
+static int batch(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Extract still images from videos without the UI");
+    parser.addHelpOption();
+
+    QCommandLineOption batchOpt("batch", "Run without the UI.");
+    QCommandLineOption intervalOpt("interval", "Save one still per <frames> frames.", "frames", "30");
+    QCommandLineOption selectOpt("select", "Frame to pick per interval: first, sharpest or stillest.", "mode",
+                                 "first");
+    QCommandLineOption timesOpt("times", "Save the stills at these times in seconds instead of per interval.",
+                                "t1,t2,...");
+    QCommandLineOption roiOpt("roi", "Region scored for sharpness, in frame pixels.", "x,y,w,h");
+    QCommandLineOption curveOpt("motion-curve", "Write the motion of every frame to <video>-motion.csv.");
+    QCommandLineOption dedupeOpt("dedupe", "Skip stills within <bits> of the perceptual hash of the last one saved.",
+                                 "bits");
+    QCommandLineOption streamOpt("stream", "Write the stills as one Y4M stream to <file>, - for standard output.",
+                                 "file");
+    QCommandLineOption rawOpt("raw", "Stream raw planes without Y4M framing, described by a JSON sidecar.");
+    QCommandLineOption sidecarOpt("sidecar", "JSON sidecar of a raw stream, <file>.json by default.", "file");
+    QCommandLineOption metricsOpt("metrics", "Write packets, bytes, frames and saves of the run to <file> as JSON.",
+                                  "file");
+    QCommandLineOption jobsOpt("jobs", "Files decoded at once.", "count",
+                               QString::number(qMax(int(std::thread::hardware_concurrency()) / 4, 1)));
+    QCommandLineOption threadsOpt("threads", "Threads to use for decoding and encoding, all cores by default.",
+                                  "count");
+    QCommandLineOption perDeviceOpt("per-device", "Files read at once from one storage device.", "count", "2");
+    QCommandLineOption reportOpt("report", "Write the timings of every file to <file> as CSV.", "file");
+    QCommandLineOption outOpt("output", "Directory to write stills to.", "dir",
+                              QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
+    for (const auto &opt: {batchOpt, intervalOpt, selectOpt, timesOpt, roiOpt, curveOpt, dedupeOpt, streamOpt, rawOpt,
+                           sidecarOpt, metricsOpt, jobsOpt, threadsOpt, perDeviceOpt, reportOpt, outOpt})
+        parser.addOption(opt);
+    parser.addPositionalArgument("files", "Videos to extract from, or directories to search for them.", "files...");
+
+    parser.process(app);
+
+    BatchExtractor::Options opts;
+    opts.outDir = parser.value(outOpt);
+    opts.interval = parser.value(intervalOpt).toInt();
+    opts.curve = parser.isSet(curveOpt);
+    opts.stream = parser.value(streamOpt);
+    opts.raw = parser.isSet(rawOpt);
+    opts.sidecar = parser.value(sidecarOpt);
+#ifndef Q_OS_UNIX
+    if (!opts.stream.isEmpty()) {
+        qCritical() << "--stream is not available on this system";
+        return 1;
+    }
+#endif
+    if (parser.isSet(dedupeOpt))
+        opts.dedupe = qBound(0, parser.value(dedupeOpt).toInt(), 64);
+
+    const auto select = parser.value(selectOpt);
+    if (select == "sharpest")
+        opts.select = BatchExtractor::Selection::Sharpest;
+    else if (select == "stillest")
+        opts.select = BatchExtractor::Selection::Stillest;
+    else if (select != "first") {
+        qCritical() << "unknown selection" << select;
+        return 1;
+    }
+
+    if (parser.isSet(timesOpt)) {
+        // exact times leave nothing to choose from
+        if (opts.select != BatchExtractor::Selection::First) {
+            qCritical() << "--times cannot be combined with --select" << select;
+            return 1;
+        }
+
+        for (const auto &part: parser.value(timesOpt).split(',')) {
+            bool ok;
+            const auto time = part.toDouble(&ok);
+            if (!ok || time < 0) {
+                qCritical() << "invalid time" << part;
+                return 1;
+            }
+            opts.times.push_back(time);
+        }
+    }
+
+    if (parser.isSet(roiOpt)) {
+        const auto parts = parser.value(roiOpt).split(',');
+        if (parts.size() != 4) {
+            qCritical() << "region must be given as x,y,w,h";
+            return 1;
+        }
+        opts.roi = QRect(parts[0].toInt(), parts[1].toInt(), parts[2].toInt(), parts[3].toInt());
+    }
+
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    const auto files = BatchRunner::collect(parser.positionalArguments());
+    if (files.isEmpty()) {
+        qCritical() << "no videos found";
+        return 1;
+    }
+
+    if (parser.isSet(threadsOpt))
+        ThreadBudget::setTotal(parser.value(threadsOpt).toInt());
+
+    BatchRunner::Limits limits;
+    limits.jobs = parser.value(jobsOpt).toInt();
+    limits.perDevice = parser.value(perDeviceOpt).toInt();
+
+    BatchRunner runner(opts, limits);
+    int rc = runner.run(files) ? 0 : 1;
+    runner.report();
+
+    if (parser.isSet(reportOpt) && !runner.writeReport(parser.value(reportOpt)))
+        rc = 1;
+    if (parser.isSet(metricsOpt) && !runner.metrics().write(parser.value(metricsOpt)))
+        rc = 1;
+
+    return rc;
+}
+
+#ifdef Q_OS_UNIX
+static int server(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serve frames of videos over a Unix domain socket");
+    parser.addHelpOption();
+
+    auto runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (runtimeDir.isEmpty())
+        runtimeDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+
+    QCommandLineOption serverOpt("server", "Run as frame server without the UI.");
+    QCommandLineOption socketOpt("socket", "Path of the socket to listen on.", "path", runtimeDir + "/visie.sock");
+    QCommandLineOption videosOpt("videos", "Videos kept open between requests.", "count", "8");
+    QCommandLineOption workersOpt("workers", "Threads decoding and encoding frames.", "count",
+                                  QString::number(qMax(int(std::thread::hardware_concurrency()) / 2, 1)));
+    for (const auto &opt: {serverOpt, socketOpt, videosOpt, workersOpt})
+        parser.addOption(opt);
+
+    parser.process(app);
+
+    FrameServer srv(qMax(parser.value(videosOpt).toInt(), 1), qMax(parser.value(workersOpt).toInt(), 1));
+    if (!srv.listen(parser.value(socketOpt)))
+        return 1;
+
+    srv.run();
+    return 1;
+}
+#endif
 
 int main(int argc, char *argv[])
 {
+    // trace the whole run
+    const auto traceFile = qEnvironmentVariable("VISIE_TRACE");
+    if (!traceFile.isEmpty())
+        Tracer::dumpAtExit(traceFile);
+
+    // batch runs and the server need no display
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--batch")) {
+            QCoreApplication a(argc, argv);
+            return batch(a);
+        }
+        if (!strcmp(argv[i], "--server")) {
+#ifdef Q_OS_UNIX
+            QCoreApplication a(argc, argv);
+            return server(a);
+#else
+            qCritical() << "--server is not available on this system";
+            return 1;
+#endif
+        }
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -2,10 +2,14 @@
 #include "ui_mainwindow.h"
 
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QDebug>
 #include <QStandardPaths>
-#include <QGraphicsPixmapItem>
 #include <QKeyEvent>
+#include <QSignalBlocker>
+#include <QActionGroup>
+#include <QStringList>
+#include "tracer.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -14,22 +18,67 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
 
     installEventFilter(this);
-    connect(&proc, &VideoProcessor::loadSuccess, this, &MainWindow::videoLoaded);
-    connect(&proc, &VideoProcessor::loadError, this, &MainWindow::loadFailed);
-    connect(&proc, &VideoProcessor::streamLength, this, &MainWindow::setFrames);
-    connect(&proc, &VideoProcessor::imgReady, this, &MainWindow::showImg);
-    connect(ui->frameSlider, &QSlider::valueChanged, &proc, &VideoProcessor::present);
+    connect(ui->frameSlider, &QSlider::valueChanged, this, [this](int value) {
+        proc->present(value);
+    });
+
+    // rubber band selection of the area to save
+    connect(ui->frameView, &FrameView::areaSelected, this, &MainWindow::selectArea);
+
+    overlay = new QLabel(ui->frameView);
+    overlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+    overlay->setStyleSheet("background: rgba(0, 0, 0, 160); color: white; font-family: monospace; padding: 6px;");
+    overlay->move(8, 8);
+    overlay->hide();
+
+    // playback speed
+    speed = 1;
+    auto speeds = new QActionGroup(this);
+    for (auto [action, factor]: {std::make_pair(ui->actionSpeed1, 1), std::make_pair(ui->actionSpeed2, 2),
+                                std::make_pair(ui->actionSpeed4, 4), std::make_pair(ui->actionSpeed8, 8)}) {
+        action->setData(factor);
+        speeds->addAction(action);
+    }
+    connect(speeds, &QActionGroup::triggered, this, &MainWindow::setSpeed);
 
     titleBase = windowTitle();
+
+#ifndef Q_OS_UNIX
+    // shared memory export is built on POSIX systems only
+    ui->actionSharedMemory->setVisible(false);
+#endif
+
+    // frame buffers of all open videos, in MiB
+    const auto budget = qEnvironmentVariableIntValue("VISIE_VIDEO_MEMORY");
+    if (budget > 0)
+        session.setMemoryBudget(int64_t(budget) << 20);
+
+    // the window follows whichever video of the session is current
+    proc = nullptr;
+    connect(&session, &Session::activated, this, &MainWindow::videoActivated);
+    videoActivated(session.currentVideo(), nullptr);
 }
 
 MainWindow::~MainWindow()
 {
+    // the session outlives ui, stopping playback as it goes must not reach the window anymore
+    disconnect(&session, nullptr, this, nullptr);
+    disconnect(proc, nullptr, this, nullptr);
     delete ui;
 }
 
 
 void MainWindow::on_actionOpen_triggered()
+{
+    openVideo(false);
+}
+
+void MainWindow::on_actionAddVideo_triggered()
+{
+    openVideo(true);
+}
+
+void MainWindow::openVideo(bool add)
 {
     statusBar()->clearMessage();
 
@@ -39,13 +88,19 @@ void MainWindow::on_actionOpen_triggered()
 
     // load file
     if (! fn.isEmpty()) {
-        proc.setDimensions(ui->graphicsView->width(), ui->graphicsView->height());
+        session.setDimensions(ui->frameView->width(), ui->frameView->height());
+        if (add)
+            session.add();
 
         curFn = fn;
-        QFileInfo videoFile(fn);
-        setWindowTitle(titleBase + " - " + videoFile.fileName());
+        selection = QRectF();
+        proc->loadVideo(fn);
 
-        proc.loadVideo(fn);
+        // an added video that failed leaves the session again
+        if (!proc->file().isEmpty())
+            updateTitle();
+        else if (add && session.count() > 1)
+            session.removeCurrent();
     }
 
 }
@@ -55,7 +110,7 @@ void MainWindow::videoLoaded()
     statusBar()->showMessage("Video loaded");
 
     ui->frameSlider->setValue(0);
-    proc.present(0);
+    proc->present(0);
 }
 
 void MainWindow::loadFailed(QString msg)
@@ -64,6 +119,84 @@ void MainWindow::loadFailed(QString msg)
     resetUI();
 }
 
+void MainWindow::videoActivated(VideoProcessor *video, VideoProcessor *previous)
+{
+    if (video != previous) {
+        if (previous)
+            disconnect(previous, nullptr, this, nullptr);
+
+        proc = video;
+        connect(proc, &VideoProcessor::loadSuccess, this, &MainWindow::videoLoaded);
+        connect(proc, &VideoProcessor::loadError, this, &MainWindow::loadFailed);
+        connect(proc, &VideoProcessor::streamLength, this, &MainWindow::setFrames);
+        connect(proc, &VideoProcessor::imgReady, this, &MainWindow::showImg);
+        connect(proc, &VideoProcessor::positionChanged, this, &MainWindow::setPosition);
+        connect(proc, &VideoProcessor::playbackChanged, this, &MainWindow::playbackChanged);
+        connect(proc, &VideoProcessor::frameSaved, this, &MainWindow::frameSaved);
+    }
+
+    selection = QRectF();
+    playbackChanged(proc->isPlaying());
+    {
+        const QSignalBlocker blocker(ui->actionSharedMemory);
+        ui->actionSharedMemory->setChecked(session.ringExport());
+    }
+    if (proc->file().isEmpty()) {
+        ui->frameView->clear();
+        showSelection();
+        resetUI();
+        return;
+    }
+
+    // the video kept its position and frame
+    updateTitle();
+    setFrames(proc->duration());
+    proc->refresh();
+}
+
+void MainWindow::on_actionCloseVideo_triggered()
+{
+    session.removeCurrent();
+}
+
+void MainWindow::on_actionNextVideo_triggered()
+{
+    session.activate((session.currentIndex() + 1) % session.count());
+}
+
+void MainWindow::on_actionPrevVideo_triggered()
+{
+    session.activate((session.currentIndex() + session.count() - 1) % session.count());
+}
+
+void MainWindow::on_actionSyncVideos_triggered()
+{
+    const auto synced = session.syncToCurrent();
+    statusBar()->showMessage(QString("%1 of %2 other videos recorded this moment").arg(synced)
+                                 .arg(session.count() - 1));
+}
+
+void MainWindow::on_actionClockOffset_triggered()
+{
+    // seconds the camera's clock was behind, for syncing with videos of other cameras
+    bool ok;
+    const auto index = session.currentIndex();
+    const auto seconds = QInputDialog::getDouble(this, tr("Camera Clock Offset"),
+        tr("Seconds to add to the recording time of this video:"), session.clockOffset(index), -86400, 86400, 3, &ok);
+    if (ok)
+        session.setClockOffset(index, seconds);
+}
+
+void MainWindow::updateTitle()
+{
+    // which of several videos is shown
+    auto title = titleBase + " - " + QFileInfo(proc->file()).fileName();
+    if (session.count() > 1)
+        title += QString(" (%1/%2)").arg(session.currentIndex() + 1).arg(session.count());
+
+    setWindowTitle(title);
+}
+
 void MainWindow::setFrames(int64_t count)
 {
     ui->frameSlider->setMaximum(count);
@@ -72,15 +205,52 @@ void MainWindow::setFrames(int64_t count)
 
 void MainWindow::showImg(QImage img)
 {
-    const auto view = ui->graphicsView;
-    auto scene = ui->graphicsView->scene();
-    if (!scene) {
-        scene = new QGraphicsScene(view->viewport()->rect(), this);
-        view->setScene(scene);
-    }
+    // only what changed is painted, straight from the converted image
+    ui->frameView->setImage(img);
+    updateOverlay();
+}
+
+void MainWindow::updateOverlay()
+{
+    if (!overlay->isVisible())
+        return;
+
+    const auto &metrics = proc->metrics();
+    const auto frm = metrics.lastFrame();
+    const auto opening = metrics.opening();
+    const auto count = [&metrics](Metrics::Counter counter) {
+        return metrics.value(counter);
+    };
+
+    // many decoded frames point at long GOPs, many bytes at I/O, the rest is conversion
+    QStringList lines;
+    lines << QString("first frame %1 ms, opened in %2 ms%3").arg(opening.firstFrameMs, 0, 'f', 1)
+                 .arg(opening.openMs, 0, 'f', 1).arg(opening.probed ? " (probed)" : "")
+          << ""
+          << QString("seek        %1 ms%2").arg(frm.seekMs, 0, 'f', 1).arg(frm.prefetched ? " (prefetched)" : "")
+          << QString("packets     %1, %2 KiB").arg(frm.packets).arg(frm.bytes / 1024)
+          << QString("decoded     %1 for 1 shown").arg(frm.decoded)
+          << QString("conversion  %1 ms").arg(frm.convertMs, 0, 'f', 1)
+          << QString("to pixel    %1 ms").arg(frm.totalMs, 0, 'f', 1)
+          << QString("display     %1 fps, painted in %2 ms").arg(ui->frameView->framesPerSecond(), 0, 'f', 1)
+                 .arg(ui->frameView->paintMs(), 0, 'f', 1)
+          << ""
+          << QString("seeks %1, steps %2 prefetched / %3 decoded").arg(count(Metrics::Seeks))
+                 .arg(count(Metrics::PrefetchHits)).arg(count(Metrics::PrefetchMisses))
+          << QString("read %1 MiB in %2 packets, %3 frames decoded / %4 shown / %5 dropped")
+                 .arg(count(Metrics::BytesRead) / double(1 << 20), 0, 'f', 1).arg(count(Metrics::PacketsRead))
+                 .arg(count(Metrics::FramesDecoded)).arg(count(Metrics::FramesShown))
+                 .arg(count(Metrics::FramesDropped))
+          << QString("saves in flight %1, %2 started, %3 failed").arg(count(Metrics::SavesInFlight))
+                 .arg(count(Metrics::SavesStarted)).arg(count(Metrics::SavesFailed));
 
-    scene->clear();
-    scene->addPixmap(QPixmap::fromImage(img));
+    overlay->setText(lines.join("\n"));
+    overlay->adjustSize();
+}
+
+void MainWindow::showSelection()
+{
+    ui->frameView->setSelection(selection);
 }
 
 void MainWindow::resetUI()
@@ -93,12 +263,12 @@ void MainWindow::resizeEvent(QResizeEvent *)
 {
     qDebug() << __FUNCTION__;
 
-    auto scene = ui->graphicsView->scene();
-    if (scene) {
-        auto rect = ui->graphicsView->viewport()->rect();
-        scene->setSceneRect(rect);
-        proc.setDimensions(rect.width(), rect.height());
-        proc.present(ui->frameSlider->value());
+    if (!proc->file().isEmpty()) {
+        // the image gets scaled anew
+        selection = QRectF();
+        showSelection();
+        session.setDimensions(ui->frameView->width(), ui->frameView->height());
+        proc->present(ui->frameSlider->value());
     }
 }
 
@@ -108,8 +278,7 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
         auto ev = reinterpret_cast<QKeyEvent *>(event);
 
         if (ev->key() == Qt::Key_Left || ev->key() == Qt::Key_Right) {
-            auto pts = proc.presentPrevNext(ev->key() == Qt::Key_Left);
-            ui->frameSlider->setValue(pts);
+            setPosition(proc->presentPrevNext(ev->key() == Qt::Key_Left));
         }
     }
 
@@ -118,5 +287,114 @@ bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 
 void MainWindow::on_actionSave_triggered()
 {
-    proc.saveFrame();
+    proc->saveFrame(selection);
+}
+
+void MainWindow::on_actionSaveStackedMedian_triggered()
+{
+    proc->saveStacked(stackRadius, true);
+}
+
+void MainWindow::on_actionSaveStackedMean_triggered()
+{
+    proc->saveStacked(stackRadius, false);
+}
+
+void MainWindow::on_actionSaveBurst_triggered()
+{
+    proc->saveBurst(burstLength);
+}
+
+void MainWindow::on_actionSharedMemory_toggled(bool on)
+{
+    session.setRingExport(on);
+}
+
+void MainWindow::on_actionRecordTrace_toggled(bool on)
+{
+    if (on) {
+        Tracer::start();
+        return;
+    }
+
+    Tracer::stop();
+
+    auto fn = QFileDialog::getSaveFileName(this, tr("Save Trace"),
+        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/visie-trace.json",
+        tr("Chrome Trace (*.json)"));
+    if (!fn.isEmpty())
+        Tracer::dump(fn);
+}
+
+void MainWindow::on_actionPerfOverlay_toggled(bool on)
+{
+    overlay->setVisible(on);
+    updateOverlay();
+}
+
+void MainWindow::on_actionPlay_triggered()
+{
+    if (proc->isPlaying())
+        proc->pause();
+    else
+        proc->play(speed);
+}
+
+void MainWindow::on_actionSnapSharpest_triggered()
+{
+    // sharpest within the selected area if any, as it is saved
+    setPosition(proc->presentSharpest(snapRadius, selection));
+}
+
+void MainWindow::on_actionSnapStillest_triggered()
+{
+    const auto pts = proc->presentStillest(snapRadius);
+    if (pts == AV_NOPTS_VALUE)
+        statusBar()->showMessage("No motion data around this frame yet");
+    else
+        setPosition(pts);
+}
+
+void MainWindow::on_actionClearSelection_triggered()
+{
+    selection = QRectF();
+    showSelection();
+}
+
+void MainWindow::selectArea(QRectF area)
+{
+    selection = area;
+    showSelection();
+    if (!selection.isEmpty())
+        statusBar()->showMessage("Saving only the selected area, Esc to clear");
+}
+
+void MainWindow::setSpeed(QAction *action)
+{
+    speed = action->data().toInt();
+
+    if (proc->isPlaying())
+        proc->play(speed);
+}
+
+void MainWindow::playbackChanged(bool playing)
+{
+    ui->actionPlay->setText(playing ? "Pause" : "Play");
+}
+
+void MainWindow::frameSaved(QString fileName, bool success)
+{
+    if (success)
+        statusBar()->showMessage("Saved " + fileName);
+    else
+        statusBar()->showMessage("Saving failed: " + fileName);
+
+    updateOverlay();
+}
+
+void MainWindow::setPosition(int64_t pts)
+{
+    // follow with the slider without triggering another seek
+    QSignalBlocker blocker(ui->frameSlider);
+    ui->frameSlider->setValue(pts);
 }
@@ -1,9 +1,10 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
-#include "videoprocessor.h"
+#include "session.h"
 
 #include <QMainWindow>
+#include <QLabel>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -19,20 +20,61 @@ public:
 
 private slots:
     void on_actionOpen_triggered();
+    void on_actionAddVideo_triggered();
+    void on_actionCloseVideo_triggered();
+    void on_actionNextVideo_triggered();
+    void on_actionPrevVideo_triggered();
+    void on_actionSyncVideos_triggered();
+    void on_actionClockOffset_triggered();
+    void videoActivated(VideoProcessor *video, VideoProcessor *previous);
     void videoLoaded();
     void loadFailed(QString msg);
     void setFrames(int64_t count);
     void showImg(QImage img);
 
     void on_actionSave_triggered();
+    void on_actionSaveStackedMedian_triggered();
+    void on_actionSaveStackedMean_triggered();
+    void on_actionSaveBurst_triggered();
+    void on_actionSharedMemory_toggled(bool on);
+    void on_actionRecordTrace_toggled(bool on);
+    void on_actionPlay_triggered();
+    void on_actionSnapSharpest_triggered();
+    void on_actionSnapStillest_triggered();
+    void on_actionClearSelection_triggered();
+    void on_actionPerfOverlay_toggled(bool on);
+    void selectArea(QRectF area);
+    void setSpeed(QAction *action);
+    void playbackChanged(bool playing);
+    void setPosition(int64_t pts);
+    void frameSaved(QString fileName, bool success);
 
 private:
+    // frames considered on either side when snapping to the sharpest or stillest
+    static constexpr int snapRadius = 15;
+    // frames merged on either side of the current one by stacked saves
+    static constexpr int stackRadius = 4;
+    // frames written into one file by burst saves
+    static constexpr int burstLength = 30;
+
     Ui::MainWindow *ui;
-    VideoProcessor proc;
+    Session session;
+    VideoProcessor *proc; // the current video of the session
     QString titleBase;
     QString curFn;
+    int speed;
+
+    // area to save, in presented image coordinates
+    QRectF selection;
+
+    // cost of the last frame and running totals, over the picture
+    QLabel *overlay;
 
+    void openVideo(bool add);
+    void updateTitle();
     void resetUI();
+    void showSelection();
+    void updateOverlay();
     void resizeEvent(QResizeEvent *);
     bool eventFilter(QObject* watched, QEvent* event);
 };
@@ -3,9 +3,12 @@
 
 #include <QDebug>
 #include <QDateTime>
+#include "tracer.h"
 
-MediaReader::MediaReader(AVIOContext *ctx, ExifData *exifData, int targetTrackID, double timeStamp) :
-    ctx(ctx), md(exifData), targetTrackID(targetTrackID), timeStamp(timeStamp), colorParams({2, 2, 2} /* undef */)
+MediaReader::MediaReader(AVIOContext *ctx, ExifData *exifData, int targetTrackID, double timeStamp,
+                         const FragmentIndex *fragments) :
+    ctx(ctx), md(exifData), targetTrackID(targetTrackID), currentTrackID(0), timeStamp(timeStamp),
+    colorParams({2, 2, 2} /* undef */), created(0), modified(0), timed(false), fragments(fragments)
 {
 }
 
@@ -19,6 +22,16 @@ void MediaReader::extract()
     return;
 }
 
+void MediaReader::extractAt(double timeStamp, ExifData *exifData)
+{
+    this->timeStamp = timeStamp;
+    md = exifData;
+
+    if (timed)
+        addTimes();
+    addGoProMeta();
+}
+
 void MediaReader::gps2Exif(ExifData *exifData, QString lat, QString lon)
 {
     exifData->add("Exif.GPSInfo.GPSLatitudeRef", lat[0] == '-' ? "S" : "N");
@@ -78,6 +91,9 @@ void MediaReader::decend(AVIOContext *ctx, int64_t rangeEnd)
         auto basePos = avio_tell(ctx);
         qDebug() << basePos << QString::fromLatin1(fc, 4) << atomSize;
 
+        // covers the children of container atoms
+        Tracer::Span span("atom", fc);
+
         switch(fourCC) {
             case 'moov':
             case 'trak':
@@ -203,10 +219,21 @@ void MediaReader::handle_tkhd(AVIOContext *ctx, int64_t rangeEnd)
         return;
     }
     auto track = avio_rb32(ctx);
+    currentTrackID = track;
 
     if (track != targetTrackID)
         return;
 
+    created = creat;
+    modified = mod;
+    timed = true;
+    addTimes();
+}
+
+void MediaReader::addTimes()
+{
+    auto creat = created, mod = modified;
+
     // add time stamp inside the video to values read
     double ofs;
     uint32_t frac = modf(timeStamp, &ofs) * 100;
@@ -381,11 +408,28 @@ void MediaReader::handle_mdia(AVIOContext *ctx, int64_t rangeBase, int64_t range
     if (!readingGoProMeta)
         return;
 
+    // fragmented recordings leave the sample tables empty, their samples follow in moof boxes
+    if (metaTrackSamples.empty()) {
+        if (!fragments) {
+            ownFragments.reset(new FragmentIndex);
+            ownFragments->update(ctx);
+            fragments = ownFragments.get();
+        }
+
+        metaTrackSamples = fragments->samples(currentTrackID);
+    }
+
+    goProSamples = metaTrackSamples;
+    addGoProMeta();
+}
+
+void MediaReader::addGoProMeta()
+{
     uint64_t ts = timeStamp * 1000;
 
-    auto target = metaTrackSamples.end();
+    auto target = goProSamples.end();
     uint64_t trackTimestmp = 0;
-    for (auto sample = metaTrackSamples.begin(); sample != metaTrackSamples.end(); sample++) {
+    for (auto sample = goProSamples.begin(); sample != goProSamples.end(); sample++) {
         if (ts >= trackTimestmp && ts <= trackTimestmp + sample->duration) {
             target = sample;
             break;
@@ -395,14 +439,14 @@ void MediaReader::handle_mdia(AVIOContext *ctx, int64_t rangeBase, int64_t range
 
     decltype(ts) timeOffset;
 
-    if (target == metaTrackSamples.end() && metaTrackSamples.size() > 0) {
-        target = metaTrackSamples.end() - 1;
+    if (target == goProSamples.end() && goProSamples.size() > 0) {
+        target = goProSamples.end() - 1;
         timeOffset = 999; // end of last sample
     }
     else
         timeOffset = ts - trackTimestmp;
 
-    if (target != metaTrackSamples.end()) {
+    if (target != goProSamples.end()) {
         QByteArray buf(target->size, Qt::Uninitialized);
         avio_seek(ctx, target->offset, SEEK_SET);
         avio_read(ctx, reinterpret_cast<unsigned char*>(buf.data()), target->size);
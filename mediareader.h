@@ -4,6 +4,7 @@
 #include <string>
 #include <tuple>
 #include <list>
+#include <memory>
 #include <QByteArray>
 #include <QString>
 #include "exiv2wrapper/exiv2wrapper.h"
@@ -12,27 +13,36 @@ extern "C" {
 }
 
 #include "colorparams.h"
+#include "fragmentindex.h"
 
 class MediaReader
 {
 public:
     using MetadataKV = std::tuple<std::string, std::string>;
     using Metadata = std::list<MetadataKV>;
-    using TrackSample = struct {uint64_t offset; uint64_t size; uint32_t duration;};
+    using TrackSample = FragmentIndex::Sample;
 
-    MediaReader(AVIOContext *ctx, ExifData *exifData, int targetTrackID, double timeStamp);
+    // samples of fragmented files come from fragments when given, else from parsing the file
+    MediaReader(AVIOContext *ctx, ExifData *exifData, int targetTrackID, double timeStamp,
+                const FragmentIndex *fragments = nullptr);
     void extract();
+    // after extract(), the fields that follow the time stamp for another frame of the same track
+    void extractAt(double timeStamp, ExifData *exifData);
     const ColorParams color() {return colorParams;};
     static void gps2Exif(ExifData *exifData, QString lat, QString lon);
 
 private:
     AVIOContext *ctx;
     ExifData *md;
-    uint32_t targetTrackID;
+    uint32_t targetTrackID, currentTrackID;
     double timeStamp;
     ColorParams colorParams;
+    uint64_t created, modified; // of the target track, if timed
+    bool timed;
     bool readingGoProMeta;
-    std::vector<TrackSample> metaTrackSamples;
+    std::vector<TrackSample> metaTrackSamples, goProSamples;
+    const FragmentIndex *fragments;
+    std::unique_ptr<FragmentIndex> ownFragments;
 
     static QString fourCCStr(int fourCC);
     void decend(AVIOContext *ctx, int64_t rangeEnd);
@@ -46,6 +56,8 @@ private:
     void handle_stsz(AVIOContext *ctx, int64_t rangeBase, int64_t rangeEnd);
     void handle_mdia(AVIOContext *ctx, int64_t rangeBase, int64_t rangeEnd);
     void handle_stts(AVIOContext *ctx, int64_t rangeBase, int64_t rangeEnd);
+    void addTimes();
+    void addGoProMeta();
 };
 
 #endif // MEDIAREADER_H
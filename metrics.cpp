@@ -0,0 +1,108 @@
+#include "metrics.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+
+Metrics::Metrics() : hasLast(false), hasOpened(false)
+{
+    for (auto &counter: counters)
+        counter.store(0, std::memory_order_relaxed);
+}
+
+void Metrics::setLastFrame(const Frame &frm)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    last = frm;
+    hasLast = true;
+}
+
+Metrics::Frame Metrics::lastFrame() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return last;
+}
+
+void Metrics::setOpening(const Opening &open)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    opened = open;
+    hasOpened = true;
+}
+
+Metrics::Opening Metrics::opening() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return opened;
+}
+
+QJsonObject Metrics::toJson() const
+{
+    QJsonObject root;
+    for (int c = 0; c < counterCount; c++)
+        root[name(Counter(c))] = qint64(value(Counter(c)));
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (hasOpened) {
+        root["first_frame"] = QJsonObject {
+            {"open_ms", opened.openMs},
+            {"total_ms", opened.firstFrameMs},
+            {"probed", opened.probed}
+        };
+    }
+    if (hasLast) {
+        root["last_frame"] = QJsonObject {
+            {"seek_ms", last.seekMs},
+            {"convert_ms", last.convertMs},
+            {"total_ms", last.totalMs},
+            {"packets", qint64(last.packets)},
+            {"decoded", qint64(last.decoded)},
+            {"bytes", qint64(last.bytes)},
+            {"prefetched", last.prefetched}
+        };
+    }
+
+    return root;
+}
+
+bool Metrics::write(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "cannot write" << fileName;
+        return false;
+    }
+
+    file.write(QJsonDocument(toJson()).toJson());
+    return true;
+}
+
+const char *Metrics::name(Counter counter)
+{
+    switch (counter) {
+        case Seeks:
+            return "seeks";
+        case PrefetchHits:
+            return "prefetch_hits";
+        case PrefetchMisses:
+            return "prefetch_misses";
+        case FramesShown:
+            return "frames_shown";
+        case FramesDropped:
+            return "frames_dropped";
+        case PacketsRead:
+            return "packets_read";
+        case FramesDecoded:
+            return "frames_decoded";
+        case BytesRead:
+            return "bytes_read";
+        case SavesStarted:
+            return "saves_started";
+        case SavesFailed:
+            return "saves_failed";
+        case SavesInFlight:
+            return "saves_in_flight";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <QJsonObject>
+
+// running counters and the cost of the last presented frame, for the viewer's overlay and batch reports
+class Metrics
+{
+public:
+    enum Counter {
+        Seeks,
+        PrefetchHits,   // steps served by the prefetcher
+        PrefetchMisses, // steps decoded on demand
+        FramesShown,
+        FramesDropped,  // decoded for playback but late
+        PacketsRead,
+        FramesDecoded,
+        BytesRead,
+        SavesStarted,
+        SavesFailed,
+        SavesInFlight,
+        counterCount
+    };
+
+    // what it took to get one frame on screen
+    struct Frame {
+        double seekMs = 0, convertMs = 0, totalMs = 0;
+        int64_t packets = 0, decoded = 0, bytes = 0;
+        bool prefetched = false;
+    };
+
+    // what it took from opening a video to its first frame on screen
+    struct Opening {
+        double openMs = 0, firstFrameMs = 0;
+        bool probed = false;
+    };
+
+    Metrics();
+    Metrics(const Metrics &) = delete;
+
+    void add(Counter counter, int64_t n = 1) {counters[counter].fetch_add(n, std::memory_order_relaxed);}
+    int64_t value(Counter counter) const {return counters[counter].load(std::memory_order_relaxed);}
+
+    void setLastFrame(const Frame &frm);
+    Frame lastFrame() const;
+    void setOpening(const Opening &open);
+    Opening opening() const;
+
+    QJsonObject toJson() const;
+    bool write(const QString &fileName) const;
+    static const char *name(Counter counter);
+
+protected:
+    std::atomic<int64_t> counters[counterCount];
+
+    mutable std::mutex mtx;
+    Frame last;
+    Opening opened;
+    bool hasLast, hasOpened;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,167 @@
+#include "motionscanner.h"
+
+#include <QDebug>
+#include "jobscheduler.h"
+#include "stillness.h"
+#include "threadbudget.h"
+
+MotionScanner::MotionScanner() : pool(nullptr), stop(false), done(false), running(false), scanned(AV_NOPTS_VALUE)
+{
+    frm = av_frame_alloc();
+}
+
+MotionScanner::~MotionScanner()
+{
+    close();
+    av_frame_free(&frm);
+}
+
+void MotionScanner::open(const QString &fn, FramePool *pool)
+{
+    close();
+
+    fileName = fn;
+    this->pool = pool;
+    resume();
+}
+
+void MotionScanner::close()
+{
+    suspend();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    fileName.clear();
+    samples.clear();
+    scanned = AV_NOPTS_VALUE;
+    done = false;
+}
+
+void MotionScanner::suspend()
+{
+    stop = true;
+    wait();
+    stop = false;
+
+    // no slice runs now, release the decoder and the frames it holds
+    src.close();
+    av_frame_unref(frm);
+    meter.reset();
+}
+
+void MotionScanner::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (running || done || fileName.isEmpty())
+            return;
+        running = true;
+    }
+
+    post();
+}
+
+bool MotionScanner::covers(int64_t from, int64_t to) const
+{
+    // scanning runs from the start, so everything up to the latest frame seen is known
+    Q_UNUSED(from)
+
+    std::lock_guard<std::mutex> lock(mtx);
+    return done || (scanned != AV_NOPTS_VALUE && scanned >= to);
+}
+
+int64_t MotionScanner::stillest(int64_t from, int64_t to) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    int64_t best = AV_NOPTS_VALUE;
+    double least = 0;
+    for (const auto &smp: samples) {
+        if (smp.pts < from || smp.pts > to || smp.motion < 0)
+            continue;
+
+        // earliest of equally still frames
+        if (best == AV_NOPTS_VALUE || smp.motion < least || (smp.motion == least && smp.pts < best)) {
+            best = smp.pts;
+            least = smp.motion;
+        }
+    }
+
+    return best;
+}
+
+std::vector<MotionScanner::Sample> MotionScanner::curve() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return samples;
+}
+
+void MotionScanner::post()
+{
+    JobScheduler::shared().post([this]() {
+        run();
+    }, JobScheduler::Priority::Background);
+}
+
+void MotionScanner::wait()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    idle.wait(lock, [this] {return !running;});
+}
+
+bool MotionScanner::start()
+{
+    src.setExportMotionVectors(true);
+    // few threads, the scan must not slow down what is on screen
+    src.setThreads(ThreadBudget::background());
+
+    try {
+        src.open(fileName, pool);
+    }
+    catch (QString msg) {
+        qWarning() << "motion analysis disabled:" << msg;
+        return false;
+    }
+
+    // after a suspend, continue where the scan stopped
+    int64_t from;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        from = scanned;
+    }
+
+    return from == AV_NOPTS_VALUE ? src.next(frm) : src.seek(from, frm);
+}
+
+void MotionScanner::run()
+{
+    // a stopped scan is not done, whether or not it opened
+    bool more = stop || src.isOpen() || start();
+
+    for (int n = 0; more && !stop && n < sliceFrames; n++) {
+        const auto smp = Sample {FrameSource::ptsOf(frm), meter.measure(frm)};
+
+        // the frame a resumed scan seeks to is known already
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (scanned == AV_NOPTS_VALUE || smp.pts > scanned) {
+                samples.push_back(smp);
+                scanned = smp.pts;
+            }
+        }
+
+        more = src.next(frm);
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    if (more && !stop) {
+        // queued behind what else waits, the slice goes on later
+        lock.unlock();
+        post();
+        return;
+    }
+
+    done = !more;
+    running = false;
+    lock.unlock();
+    idle.notify_all();
+}
@@ -0,0 +1,64 @@
+#ifndef MOTIONSCANNER_H
+#define MOTIONSCANNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <QString>
+
+#include "framesource.h"
+#include "stillness.h"
+
+// builds the stillness curve of a whole clip from exported motion vectors, as background jobs that decode a slice
+// of the clip each and queue the next one, so the scan never holds a worker for long
+class MotionScanner
+{
+public:
+    struct Sample {
+        int64_t pts;
+        double motion; // negative if unknown
+    };
+
+    MotionScanner();
+    MotionScanner(const MotionScanner &) = delete;
+    ~MotionScanner();
+
+    void open(const QString &fn, FramePool *pool = nullptr);
+    void close();
+    // stops decoding but keeps the curve, resume() continues after the last frame scanned
+    void suspend();
+    void resume();
+
+    bool complete() const {return done;};
+    bool covers(int64_t from, int64_t to) const;
+    int64_t stillest(int64_t from, int64_t to) const;
+    std::vector<Sample> curve() const;
+
+protected:
+    // frames decoded per job
+    static constexpr int sliceFrames = 50;
+
+    QString fileName;
+    FramePool *pool;
+    mutable std::mutex mtx;
+    std::condition_variable idle;
+    std::atomic<bool> stop, done;
+    bool running; // a slice queued or under way, protected by mtx
+
+    // used by the slice under way only, the frame at hand is the next one to measure
+    FrameSource src;
+    AVFrame *frm;
+    Stillness meter;
+
+    // in decoding order, protected by mtx
+    std::vector<Sample> samples;
+    int64_t scanned;
+
+    void post();
+    void wait();
+    bool start();
+    void run();
+};
+
+#endif // MOTIONSCANNER_H
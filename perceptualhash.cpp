@@ -0,0 +1,149 @@
+#include "perceptualhash.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PHASH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define PHASH_NEON
+#include <arm_neon.h>
+#endif
+
+bool PerceptualHash::compute(const AVFrame *frm, uint64_t &hash)
+{
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(frm->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE)))
+        return false;
+    if (frm->width < gridSize || frm->height < gridSize)
+        return false;
+
+    // luma interleaved with chroma (YUYV and the like) is not supported
+    const auto &luma = desc->comp[0];
+    if (luma.step != (luma.depth > 8 ? 2 : 1))
+        return false;
+
+    // cell means of the luma plane, the scale of the samples does not matter for the hash
+    double grid[gridSize][gridSize] = {};
+
+    for (int cy = 0; cy < gridSize; cy++) {
+        const int y0 = cy * frm->height / gridSize, y1 = (cy + 1) * frm->height / gridSize;
+        for (int y = y0; y < y1; y++) {
+            const auto row = frm->data[0] + ptrdiff_t(frm->linesize[0]) * y + luma.offset;
+            for (int cx = 0; cx < gridSize; cx++) {
+                const int x0 = cx * frm->width / gridSize, x1 = (cx + 1) * frm->width / gridSize;
+                if (luma.depth > 8)
+                    grid[cy][cx] += rowSum16(reinterpret_cast<const uint16_t *>(row) + x0, x1 - x0);
+                else
+                    grid[cy][cx] += rowSum8(row + x0, x1 - x0);
+            }
+        }
+
+        for (int cx = 0; cx < gridSize; cx++) {
+            const int x0 = cx * frm->width / gridSize, x1 = (cx + 1) * frm->width / gridSize;
+            grid[cy][cx] /= double(x1 - x0) * (y1 - y0);
+        }
+    }
+
+    // lowest frequencies of the separable DCT-II
+    const double pi = std::acos(-1.0);
+    double basis[hashSize][gridSize];
+    for (int u = 0; u < hashSize; u++) {
+        for (int x = 0; x < gridSize; x++)
+            basis[u][x] = cos((2 * x + 1) * u * pi / (2 * gridSize));
+    }
+
+    double rows[gridSize][hashSize];
+    for (int y = 0; y < gridSize; y++) {
+        for (int u = 0; u < hashSize; u++) {
+            double sum = 0;
+            for (int x = 0; x < gridSize; x++)
+                sum += grid[y][x] * basis[u][x];
+            rows[y][u] = sum;
+        }
+    }
+
+    double coeffs[hashSize * hashSize];
+    for (int v = 0; v < hashSize; v++) {
+        for (int u = 0; u < hashSize; u++) {
+            double sum = 0;
+            for (int y = 0; y < gridSize; y++)
+                sum += rows[y][u] * basis[v][y];
+            coeffs[v * hashSize + u] = sum;
+        }
+    }
+
+    // one bit per coefficient above the median, the DC term would dominate it
+    double ac[hashSize * hashSize - 1];
+    std::copy(coeffs + 1, coeffs + hashSize * hashSize, ac);
+    const auto mid = ac + (hashSize * hashSize - 1) / 2;
+    std::nth_element(ac, mid, ac + hashSize * hashSize - 1);
+
+    hash = 0;
+    for (int i = 0; i < hashSize * hashSize; i++) {
+        if (coeffs[i] > *mid)
+            hash |= uint64_t(1) << i;
+    }
+
+    return true;
+}
+
+int PerceptualHash::distance(uint64_t a, uint64_t b)
+{
+    return std::bitset<64>(a ^ b).count();
+}
+
+uint64_t PerceptualHash::rowSum8(const uint8_t *p, int n)
+{
+    uint64_t sum = 0;
+    int i = 0;
+#if defined(PHASH_SSE2)
+    const auto zero = _mm_setzero_si128();
+    auto acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), zero));
+    sum += uint64_t(_mm_cvtsi128_si32(acc)) + uint64_t(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(PHASH_NEON)
+    auto acc = vdupq_n_u32(0);
+    for (; i + 16 <= n; i += 16)
+        acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(p + i)));
+    sum += vaddvq_u32(acc);
+#endif
+    for (; i < n; i++)
+        sum += p[i];
+
+    return sum;
+}
+
+uint64_t PerceptualHash::rowSum16(const uint16_t *p, int n)
+{
+    uint64_t sum = 0;
+    int i = 0;
+#if defined(PHASH_SSE2)
+    const auto zero = _mm_setzero_si128();
+    auto acc = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+    }
+
+    alignas(16) uint32_t s[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(s), acc);
+    sum += uint64_t(s[0]) + s[1] + s[2] + s[3];
+#elif defined(PHASH_NEON)
+    auto acc = vdupq_n_u32(0);
+    for (; i + 8 <= n; i += 8)
+        acc = vpadalq_u16(acc, vld1q_u16(p + i));
+    sum += vaddvq_u32(acc);
+#endif
+    for (; i < n; i++)
+        sum += p[i];
+
+    return sum;
+}
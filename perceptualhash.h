@@ -0,0 +1,29 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// 64 bit DCT hash of the luma plane, close for frames that look alike
+class PerceptualHash
+{
+public:
+    // false for formats without a plain luma plane
+    static bool compute(const AVFrame *frm, uint64_t &hash);
+    // number of differing bits, 0 to 64
+    static int distance(uint64_t a, uint64_t b);
+
+protected:
+    // luma is box-averaged to gridSize x gridSize before the transform
+    static constexpr int gridSize = 32;
+    // the lowest hashSize x hashSize frequencies make up the hash
+    static constexpr int hashSize = 8;
+
+    static uint64_t rowSum8(const uint8_t *p, int n);
+    static uint64_t rowSum16(const uint16_t *p, int n);
+};
+
+#endif // PERCEPTUALHASH_H
@@ -0,0 +1,263 @@
+#include "pixelkernels.h"
+
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// source layout of a pixel format, everything a kernel needs to know at compile time
+template<typename S, int Depth, int Log2W, int Log2H, bool SemiPlanar, int Shift = 0, bool SwapUV = false>
+struct Layout {
+    using Sample = S;
+    static constexpr int depth = Depth;
+    static constexpr int log2ChromaW = Log2W, log2ChromaH = Log2H;
+    static constexpr bool semiPlanar = SemiPlanar;
+    static constexpr int shift = Shift;     // msb-aligned samples are moved down by this
+    static constexpr bool swapUV = SwapUV;  // Cr before Cb in interleaved chroma
+};
+
+// one trait per supported format
+template<AVPixelFormat F> struct Traits;
+
+template<> struct Traits<AV_PIX_FMT_YUV420P> : Layout<uint8_t, 8, 1, 1, false> {};
+template<> struct Traits<AV_PIX_FMT_YUVJ420P> : Traits<AV_PIX_FMT_YUV420P> {};
+template<> struct Traits<AV_PIX_FMT_YUV422P> : Layout<uint8_t, 8, 1, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_YUVJ422P> : Traits<AV_PIX_FMT_YUV422P> {};
+template<> struct Traits<AV_PIX_FMT_YUV444P> : Layout<uint8_t, 8, 0, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_YUVJ444P> : Traits<AV_PIX_FMT_YUV444P> {};
+template<> struct Traits<AV_PIX_FMT_YUV420P10LE> : Layout<uint16_t, 10, 1, 1, false> {};
+template<> struct Traits<AV_PIX_FMT_YUV422P10LE> : Layout<uint16_t, 10, 1, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_YUV444P10LE> : Layout<uint16_t, 10, 0, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_YUV420P12LE> : Layout<uint16_t, 12, 1, 1, false> {};
+template<> struct Traits<AV_PIX_FMT_YUV422P12LE> : Layout<uint16_t, 12, 1, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_YUV444P12LE> : Layout<uint16_t, 12, 0, 0, false> {};
+template<> struct Traits<AV_PIX_FMT_NV12> : Layout<uint8_t, 8, 1, 1, true> {};
+template<> struct Traits<AV_PIX_FMT_NV21> : Layout<uint8_t, 8, 1, 1, true, 0, true> {};
+template<> struct Traits<AV_PIX_FMT_NV16> : Layout<uint8_t, 8, 1, 0, true> {};
+template<> struct Traits<AV_PIX_FMT_NV24> : Layout<uint8_t, 8, 0, 0, true> {};
+template<> struct Traits<AV_PIX_FMT_P010LE> : Layout<uint16_t, 10, 1, 1, true, 6> {};
+template<> struct Traits<AV_PIX_FMT_P012LE> : Layout<uint16_t, 12, 1, 1, true, 4> {};
+template<> struct Traits<AV_PIX_FMT_P210LE> : Layout<uint16_t, 10, 1, 0, true, 6> {};
+template<> struct Traits<AV_PIX_FMT_P410LE> : Layout<uint16_t, 10, 0, 0, true, 6> {};
+
+// one row of a plane, S to D moving samples down by Shift
+template<typename S, typename D, int Shift>
+void planarRow(const S *src, D *dst, int n)
+{
+    int i = 0;
+#if defined(KERNELS_SSE2)
+    if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, uint16_t>) {
+        for (; i + 8 <= n; i += 8) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_srli_epi16(a, Shift));
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint8_t> && std::is_same_v<D, int32_t>) {
+        const auto zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            const auto lo = _mm_unpacklo_epi8(a, zero), hi = _mm_unpackhi_epi8(a, zero);
+            const auto out = reinterpret_cast<__m128i *>(dst + i);
+            _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, int32_t>) {
+        const auto zero = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8) {
+            const auto a = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), Shift);
+            const auto out = reinterpret_cast<__m128i *>(dst + i);
+            _mm_storeu_si128(out, _mm_unpacklo_epi16(a, zero));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(a, zero));
+        }
+    }
+#elif defined(KERNELS_NEON)
+    if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, uint16_t> && Shift > 0) {
+        for (; i + 8 <= n; i += 8)
+            vst1q_u16(dst + i, vshrq_n_u16(vld1q_u16(src + i), Shift));
+    }
+    else if constexpr (std::is_same_v<S, uint8_t> && std::is_same_v<D, int32_t>) {
+        for (; i + 8 <= n; i += 8) {
+            const auto a = vmovl_u8(vld1_u8(src + i));
+            vst1q_s32(dst + i, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(a))));
+            vst1q_s32(dst + i + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(a))));
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, int32_t>) {
+        for (; i + 8 <= n; i += 8) {
+            auto a = vld1q_u16(src + i);
+            if constexpr (Shift > 0)
+                a = vshrq_n_u16(a, Shift);
+            vst1q_s32(dst + i, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(a))));
+            vst1q_s32(dst + i + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(a))));
+        }
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = D(src[i] >> Shift);
+}
+
+// one row of interleaved chroma, split into two planes
+template<typename S, typename D, int Shift>
+void interleavedRow(const S *src, D *u, D *v, int n)
+{
+    int i = 0;
+#if defined(KERNELS_SSE2)
+    if constexpr (std::is_same_v<S, uint8_t> && std::is_same_v<D, uint8_t>) {
+        const auto mask = _mm_set1_epi16(0x00ff);
+        for (; i + 16 <= n; i += 16) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i),
+                             _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i),
+                             _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, uint16_t>) {
+        for (; i + 8 <= n; i += 8) {
+            // after shifting samples fit 15 bits, so signed packing cannot saturate
+            const auto a = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), Shift);
+            const auto b = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 8)), Shift);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i),
+                             _mm_packs_epi32(_mm_srli_epi32(_mm_slli_epi32(a, 16), 16),
+                                             _mm_srli_epi32(_mm_slli_epi32(b, 16), 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i),
+                             _mm_packs_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16)));
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, int32_t>) {
+        for (; i + 4 <= n; i += 4) {
+            const auto a = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), Shift);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i), _mm_srli_epi32(_mm_slli_epi32(a, 16), 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i), _mm_srli_epi32(a, 16));
+        }
+    }
+#elif defined(KERNELS_NEON)
+    if constexpr (std::is_same_v<S, uint8_t> && std::is_same_v<D, uint8_t>) {
+        for (; i + 16 <= n; i += 16) {
+            const auto uv = vld2q_u8(src + 2 * i);
+            vst1q_u8(u + i, uv.val[0]);
+            vst1q_u8(v + i, uv.val[1]);
+        }
+    }
+    else if constexpr (std::is_same_v<S, uint16_t> && std::is_same_v<D, uint16_t> && Shift > 0) {
+        for (; i + 8 <= n; i += 8) {
+            const auto uv = vld2q_u16(src + 2 * i);
+            vst1q_u16(u + i, vshrq_n_u16(uv.val[0], Shift));
+            vst1q_u16(v + i, vshrq_n_u16(uv.val[1], Shift));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        u[i] = D(src[2 * i] >> Shift);
+        v[i] = D(src[2 * i + 1] >> Shift);
+    }
+}
+
+// a whole plane, collapsing into a single copy when nothing changes but the padding
+template<typename S, typename D, int Shift>
+void planarPlane(const uint8_t *src, int srcStride, const PlaneTarget &dst, int w, int h)
+{
+    if constexpr (std::is_same_v<S, D> && Shift == 0) {
+        const auto row = size_t(w) * sizeof(S);
+        if (srcStride == dst.stride)
+            memcpy(dst.data, src, size_t(srcStride) * (h - 1) + row);
+        else
+            for (int y = 0; y < h; y++)
+                memcpy(dst.data + dst.stride * y, src + ptrdiff_t(srcStride) * y, row);
+    }
+    else {
+        for (int y = 0; y < h; y++)
+            planarRow<S, D, Shift>(reinterpret_cast<const S *>(src + ptrdiff_t(srcStride) * y),
+                                   reinterpret_cast<D *>(dst.data + dst.stride * y), w);
+    }
+}
+
+template<class F, typename D>
+void convert(const AVFrame *frm, const PlaneTarget dst[3])
+{
+    using S = typename F::Sample;
+    const auto cw = -((-frm->width) >> F::log2ChromaW);
+    const auto ch = -((-frm->height) >> F::log2ChromaH);
+
+    planarPlane<S, D, F::shift>(frm->data[0], frm->linesize[0], dst[0], frm->width, frm->height);
+
+    if constexpr (F::semiPlanar) {
+        const auto &u = dst[F::swapUV ? 2 : 1], &v = dst[F::swapUV ? 1 : 2];
+        for (int y = 0; y < ch; y++)
+            interleavedRow<S, D, F::shift>(reinterpret_cast<const S *>(frm->data[1] + ptrdiff_t(frm->linesize[1]) * y),
+                                           reinterpret_cast<D *>(u.data + u.stride * y),
+                                           reinterpret_cast<D *>(v.data + v.stride * y), cw);
+    }
+    else {
+        planarPlane<S, D, F::shift>(frm->data[1], frm->linesize[1], dst[1], cw, ch);
+        planarPlane<S, D, F::shift>(frm->data[2], frm->linesize[2], dst[2], cw, ch);
+    }
+}
+
+template<AVPixelFormat F>
+constexpr PixelKernels entry()
+{
+    using T = Traits<F>;
+    return {F, T::depth, T::log2ChromaW, T::log2ChromaH,
+            convert<T, typename T::Sample>, convert<T, int32_t>};
+}
+
+const PixelKernels table[] = {
+    entry<AV_PIX_FMT_YUV420P>(),
+    entry<AV_PIX_FMT_YUVJ420P>(),
+    entry<AV_PIX_FMT_YUV422P>(),
+    entry<AV_PIX_FMT_YUVJ422P>(),
+    entry<AV_PIX_FMT_YUV444P>(),
+    entry<AV_PIX_FMT_YUVJ444P>(),
+    entry<AV_PIX_FMT_YUV420P10LE>(),
+    entry<AV_PIX_FMT_YUV422P10LE>(),
+    entry<AV_PIX_FMT_YUV444P10LE>(),
+    entry<AV_PIX_FMT_YUV420P12LE>(),
+    entry<AV_PIX_FMT_YUV422P12LE>(),
+    entry<AV_PIX_FMT_YUV444P12LE>(),
+    entry<AV_PIX_FMT_NV12>(),
+    entry<AV_PIX_FMT_NV21>(),
+    entry<AV_PIX_FMT_NV16>(),
+    entry<AV_PIX_FMT_NV24>(),
+    entry<AV_PIX_FMT_P010LE>(),
+    entry<AV_PIX_FMT_P012LE>(),
+    entry<AV_PIX_FMT_P210LE>(),
+    entry<AV_PIX_FMT_P410LE>(),
+};
+
+} // namespace
+
+const PixelKernels *pixelKernels(AVPixelFormat fmt)
+{
+    // dispatch by format value
+    static const auto index = [] {
+        std::array<const PixelKernels *, AV_PIX_FMT_NB> idx {};
+        for (const auto &kern: table)
+            idx[kern.format] = &kern;
+        return idx;
+    }();
+
+    if (fmt < 0 || fmt >= AV_PIX_FMT_NB)
+        return nullptr;
+
+    return index[fmt];
+}
+
+const PixelKernels *pixelKernelTable(int &count)
+{
+    count = sizeof(table) / sizeof(table[0]);
+    return table;
+}
@@ -0,0 +1,46 @@
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+// destination of one Y, Cb or Cr plane
+struct PlaneTarget {
+    uint8_t *data;
+    ptrdiff_t stride; // bytes per row, equal to the row size for unpadded planes
+};
+
+// plane copy/convert routines for one source pixel format, specialized at compile time
+struct PixelKernels {
+    AVPixelFormat format;
+    int depth; // significant bits per sample
+    int log2ChromaW, log2ChromaH;
+
+    // lsb-aligned samples, uint8_t up to 8 bit and uint16_t above
+    void (*copy)(const AVFrame *frm, const PlaneTarget dst[3]);
+    // samples widened to int32_t, as openjpeg takes them
+    void (*widen)(const AVFrame *frm, const PlaneTarget dst[3]);
+
+    int planeWidth(int plane, int width) const {
+        return plane ? -((-width) >> log2ChromaW) : width;
+    }
+    int planeHeight(int plane, int height) const {
+        return plane ? -((-height) >> log2ChromaH) : height;
+    }
+    int bytesPerSample() const {
+        return depth > 8 ? 2 : 1;
+    }
+};
+
+// kernels for a YCbCr source format, nullptr if unsupported
+const PixelKernels *pixelKernels(AVPixelFormat fmt);
+
+// all specializations, e.g. for benchmarking
+const PixelKernels *pixelKernelTable(int &count);
+
+#endif // PIXELKERNELS_H
@@ -0,0 +1,178 @@
+#include "player.h"
+
+#include <QDebug>
+#include "threadbudget.h"
+
+Player::Player() :
+    pool(nullptr), generation(0), quit(false), restart(false), ended(false), broken(false), from(0), keyOnly(false)
+{
+    src.packetHook = [this](AVPacket *pkt) {
+        subs.feed(pkt);
+    };
+}
+
+Player::~Player()
+{
+    close();
+}
+
+void Player::open(const QString &fn, FramePool *pool)
+{
+    close();
+
+    fileName = fn;
+    this->pool = pool;
+    worker = std::thread(&Player::run, this);
+}
+
+void Player::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        quit = true;
+        generation++;
+    }
+    cond.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    clear();
+    quit = restart = ended = broken = false;
+}
+
+void Player::start(int64_t pts, bool keyframesOnly)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        generation++;
+        clear();
+
+        from = pts;
+        keyOnly = keyframesOnly;
+        restart = true;
+        ended = broken;
+    }
+    cond.notify_all();
+}
+
+void Player::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        generation++;
+        clear();
+
+        restart = false;
+        ended = broken;
+    }
+    cond.notify_all();
+}
+
+int64_t Player::front()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return queue.empty() ? AV_NOPTS_VALUE : FrameSource::ptsOf(queue.front().frm);
+}
+
+bool Player::take(int64_t clock, AVFrame *frm, QString &sub, int &dropped)
+{
+    bool found = false;
+    dropped = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // present the latest frame that is due, anything older is late
+        while (!queue.empty() && FrameSource::ptsOf(queue.front().frm) <= clock) {
+            if (found)
+                dropped++;
+
+            av_frame_unref(frm);
+            av_frame_move_ref(frm, queue.front().frm);
+            av_frame_free(&queue.front().frm);
+            sub = queue.front().sub;
+            queue.pop_front();
+            found = true;
+        }
+    }
+
+    if (found)
+        cond.notify_all();
+
+    return found;
+}
+
+bool Player::atEnd()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return ended && queue.empty();
+}
+
+bool Player::failed()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return broken;
+}
+
+void Player::run()
+{
+    try {
+        src.setThreads(ThreadBudget::player());
+        src.open(fileName, pool);
+        subs.open(src.formatContext());
+    }
+    catch (QString msg) {
+        qWarning() << "playback disabled:" << msg;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        ended = broken = true;
+        return;
+    }
+
+    auto frm = av_frame_alloc();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cond.wait(lock, [this] {return quit || restart;});
+        if (quit)
+            break;
+
+        restart = false;
+        const auto gen = generation.load();
+        const auto pts = from;
+        const auto key = keyOnly;
+        lock.unlock();
+
+        // continue right after the frame on display
+        src.setKeyframesOnly(key);
+        bool more = src.seek(pts, frm);
+
+        while (more && src.next(frm)) {
+            lock.lock();
+            cond.wait(lock, [&] {return quit || generation != gen || int(queue.size()) < queueDepth;});
+            more = !quit && generation == gen;
+            if (more)
+                queue.push_back({av_frame_clone(frm), subs.text()});
+            lock.unlock();
+        }
+
+        lock.lock();
+        if (generation == gen)
+            ended = true;
+    }
+    lock.unlock();
+
+    av_frame_free(&frm);
+    subs.close();
+    src.close();
+}
+
+void Player::clear()
+{
+    for (auto &entry: queue)
+        av_frame_free(&entry.frm);
+
+    queue.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <QString>
+
+#include "framesource.h"
+#include "subtitlereader.h"
+
+// decodes frames for playback on a worker thread into a bounded queue
+class Player
+{
+public:
+    static constexpr int queueDepth = 8;
+
+    Player();
+    Player(const Player &) = delete;
+    ~Player();
+
+    void open(const QString &fn, FramePool *pool = nullptr);
+    void close();
+
+    void start(int64_t pts, bool keyframesOnly);
+    void stop();
+
+    int64_t front();
+    bool take(int64_t clock, AVFrame *frm, QString &sub, int &dropped);
+    bool atEnd();
+    // the decoder could not be opened, playback ends right away
+    bool failed();
+
+protected:
+    QString fileName;
+    FramePool *pool;
+    FrameSource src;
+    SubtitleReader subs;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::atomic<uint64_t> generation;
+    bool quit, restart, ended, broken;
+
+    // playback request, protected by mtx
+    int64_t from;
+    bool keyOnly;
+
+    // a decoded frame and the subtitle read up to it
+    struct Entry {
+        AVFrame *frm;
+        QString sub;
+    };
+
+    std::deque<Entry> queue;
+
+    void run();
+    void clear();
+};
+
+#endif // PLAYER_H
@@ -0,0 +1,314 @@
+#include "prefetcher.h"
+
+#include <climits>
+#include <QDebug>
+#include <QtGlobal>
+#include "jobscheduler.h"
+#include "threadbudget.h"
+
+Prefetcher::Prefetcher() :
+    pool(nullptr), generation(0), stop(false), pending(false), active(false), running(false), cursor(AV_NOPTS_VALUE),
+    backward(false), depth(minDepth), lowAnchor(AV_NOPTS_VALUE), highAnchor(AV_NOPTS_VALUE)
+{
+    src.packetHook = [this](AVPacket *pkt) {
+        subs.feed(pkt);
+    };
+}
+
+Prefetcher::~Prefetcher()
+{
+    close();
+}
+
+void Prefetcher::open(const QString &fn, FramePool *pool)
+{
+    close();
+
+    fileName = fn;
+    this->pool = pool;
+
+    // the decoder opens with the first job
+    std::lock_guard<std::mutex> lock(mtx);
+    active = true;
+}
+
+void Prefetcher::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+        generation++;
+    }
+
+    // a running job sees stop and returns
+    if (filling.valid())
+        filling.wait();
+    filling = std::future<void>();
+    subs.close();
+    src.close();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    clear();
+    stop = false;
+    pending = false;
+    active = false;
+}
+
+void Prefetcher::speculate(int64_t pts, bool backward, int depth)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!active)
+            return;
+
+        cursor = pts;
+        this->backward = backward;
+        this->depth = qBound(minDepth, depth, maxDepth);
+        pending = true;
+
+        trim();
+
+        // a job under way picks up the new target
+        if (running)
+            return;
+        running = true;
+    }
+
+    filling = JobScheduler::shared().submit([this]() {
+        fill();
+    }, JobScheduler::Priority::Display);
+}
+
+void Prefetcher::cancel()
+{
+    generation++;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    clear();
+    pending = false;
+}
+
+bool Prefetcher::take(int64_t pts, bool prev, AVFrame *frm, QString &sub)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    const auto idx = indexOf(pts);
+    if (idx == INT_MIN)
+        return false;
+
+    const auto target = prev ? idx - 1 : idx + 1;
+    if (target < 0 || target >= int(ring.size()))
+        return false;
+
+    av_frame_unref(frm);
+    if (av_frame_ref(frm, ring[target].frm) < 0)
+        return false;
+
+    sub = ring[target].sub;
+    return true;
+}
+
+void Prefetcher::fill()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stop) {
+            running = false;
+            return;
+        }
+    }
+
+    if (!src.isOpen()) {
+        try {
+            src.setThreads(ThreadBudget::prefetcher());
+            src.open(fileName, pool);
+            subs.open(src.formatContext());
+        }
+        catch (QString msg) {
+            qWarning() << "prefetching disabled:" << msg;
+            std::lock_guard<std::mutex> lock(mtx);
+            active = running = false;
+            return;
+        }
+    }
+
+    auto frm = av_frame_alloc();
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stop && pending) {
+        pending = false;
+        const auto gen = generation.load();
+        const auto bwd = backward;
+
+        lock.unlock();
+        if (bwd)
+            fillBackward(gen, frm);
+        else
+            fillForward(gen, frm);
+        lock.lock();
+    }
+    running = false;
+    lock.unlock();
+
+    av_frame_free(&frm);
+}
+
+void Prefetcher::fillForward(uint64_t gen, AVFrame *frm)
+{
+    while (true) {
+        int64_t from;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stop || generation != gen || backward)
+                return;
+
+            if (indexOf(cursor) == INT_MIN)
+                clear();
+
+            if (!ring.empty()) {
+                if (int(ring.size()) - 1 - indexOf(cursor) >= depth)
+                    return;
+
+                from = FrameSource::ptsOf(ring.back().frm);
+            }
+            else
+                from = cursor;
+        }
+
+        // position own decoder on the last frame of the run
+        if (src.lastPts() != from) {
+            if (!src.seek(from, frm) || FrameSource::ptsOf(frm) != from)
+                return;
+        }
+
+        if (!src.next(frm))
+            return;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stop || generation != gen)
+            return;
+
+        if (ring.empty()) {
+            lowAnchor = from;
+        }
+        else if (FrameSource::ptsOf(ring.back().frm) != from) {
+            // run was trimmed or restarted meanwhile
+            continue;
+        }
+
+        ring.push_back({av_frame_clone(frm), subs.text()});
+        highAnchor = AV_NOPTS_VALUE;
+    }
+}
+
+void Prefetcher::fillBackward(uint64_t gen, AVFrame *frm)
+{
+    while (true) {
+        int64_t end;
+        int keep;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (stop || generation != gen || !backward)
+                return;
+
+            if (indexOf(cursor) == INT_MIN)
+                clear();
+
+            if (!ring.empty()) {
+                if (indexOf(cursor) >= depth)
+                    return;
+
+                end = FrameSource::ptsOf(ring.front().frm);
+            }
+            else
+                end = cursor;
+
+            keep = depth;
+        }
+
+        // decode the GOP preceding the run, retaining only its tail
+        if (!src.rewind(end - 1))
+            return;
+
+        std::deque<Entry> chunk;
+        while (generation == gen && src.next(frm) && FrameSource::ptsOf(frm) < end) {
+            chunk.push_back({av_frame_clone(frm), subs.text()});
+
+            if (int(chunk.size()) > keep) {
+                av_frame_free(&chunk.front().frm);
+                chunk.pop_front();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        const bool valid = !stop && generation == gen &&
+                (ring.empty() || FrameSource::ptsOf(ring.front().frm) == end);
+        if (!valid || chunk.empty()) {
+            for (auto &entry: chunk)
+                av_frame_free(&entry.frm);
+            return;
+        }
+
+        if (ring.empty())
+            highAnchor = end;
+        lowAnchor = AV_NOPTS_VALUE;
+
+        while (!chunk.empty()) {
+            ring.push_front(chunk.back());
+            chunk.pop_back();
+        }
+    }
+}
+
+int Prefetcher::indexOf(int64_t pts) const
+{
+    if (ring.empty() || pts == AV_NOPTS_VALUE)
+        return INT_MIN;
+
+    if (pts == lowAnchor)
+        return -1;
+    if (pts == highAnchor)
+        return int(ring.size());
+
+    for (size_t i = 0; i < ring.size(); i++) {
+        if (FrameSource::ptsOf(ring[i].frm) == pts)
+            return int(i);
+    }
+
+    return INT_MIN;
+}
+
+void Prefetcher::trim()
+{
+    auto idx = indexOf(cursor);
+    if (idx == INT_MIN) {
+        // stepped off the run, start over
+        clear();
+        return;
+    }
+
+    if (!backward) {
+        while (idx > keepBehind) {
+            lowAnchor = FrameSource::ptsOf(ring.front().frm);
+            av_frame_free(&ring.front().frm);
+            ring.pop_front();
+            idx--;
+        }
+    }
+    else {
+        while (int(ring.size()) - 1 - idx > keepBehind) {
+            highAnchor = FrameSource::ptsOf(ring.back().frm);
+            av_frame_free(&ring.back().frm);
+            ring.pop_back();
+        }
+    }
+}
+
+void Prefetcher::clear()
+{
+    for (auto &entry: ring)
+        av_frame_free(&entry.frm);
+
+    ring.clear();
+    lowAnchor = highAnchor = AV_NOPTS_VALUE;
+}
@@ -0,0 +1,68 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <QString>
+
+#include "framesource.h"
+#include "subtitlereader.h"
+
+// decodes frames ahead of (or behind) the stepping position as display jobs of the shared pool, one at a time
+class Prefetcher
+{
+public:
+    static constexpr int minDepth = 4;
+    static constexpr int maxDepth = 24;
+
+    Prefetcher();
+    Prefetcher(const Prefetcher &) = delete;
+    ~Prefetcher();
+
+    void open(const QString &fn, FramePool *pool = nullptr);
+    void close();
+
+    void speculate(int64_t pts, bool backward, int depth);
+    void cancel();
+    bool take(int64_t pts, bool prev, AVFrame *frm, QString &sub);
+
+protected:
+    // frames kept on the far side of the cursor so a direction change still hits
+    static constexpr int keepBehind = 2;
+
+    QString fileName;
+    FramePool *pool;
+    FrameSource src;
+    SubtitleReader subs;
+    std::future<void> filling;
+    std::mutex mtx;
+    std::atomic<uint64_t> generation;
+    bool stop, pending;
+    bool active, running; // opened and not disabled, a fill job queued or running
+
+    // speculation target, protected by mtx
+    int64_t cursor;
+    bool backward;
+    int depth;
+
+    // a decoded frame and the subtitle read up to it
+    struct Entry {
+        AVFrame *frm;
+        QString sub;
+    };
+
+    // contiguous run of decoded frames in ascending pts, plus the frames just outside of it
+    std::deque<Entry> ring;
+    int64_t lowAnchor, highAnchor;
+
+    void fill();
+    void fillForward(uint64_t gen, AVFrame *frm);
+    void fillBackward(uint64_t gen, AVFrame *frm);
+    int indexOf(int64_t pts) const;
+    void trim();
+    void clear();
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,165 @@
+#include "ringpublisher.h"
+
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+static uint64_t alignUp(uint64_t n, uint64_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+RingPublisher::RingPublisher(const QString &name, int slotCount)
+    : shmName(name), slotCount(qMax(slotCount, 2))
+{
+    base = nullptr;
+    mapped = 0;
+    width = height = planes = 0;
+    format = AV_PIX_FMT_NONE;
+}
+
+RingPublisher::~RingPublisher()
+{
+    destroy();
+}
+
+bool RingPublisher::publish(const AVFrame *frm, AVRational timeBase, const ColorParams &color,
+                            const std::vector<uint8_t> &exif)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!base || frm->width != width || frm->height != height || frm->format != format) {
+        destroy();
+        if (!create(frm))
+            return false;
+    }
+
+    const auto hdr = reinterpret_cast<FrameRing::RingHeader *>(base);
+    const auto n = hdr->published.load(std::memory_order_relaxed);
+    const auto slot = FrameRing::slotAt(base, hdr, n);
+
+    // seqlock: readers that see an odd or changed sequence drop what they read
+    slot->seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->pts = frm->best_effort_timestamp;
+    slot->timeBaseNum = timeBase.num;
+    slot->timeBaseDen = timeBase.den;
+    slot->width = frm->width;
+    slot->height = frm->height;
+    slot->format = frm->format;
+    slot->planes = planes;
+    for (int p = 0; p < 4; p++) {
+        slot->linesize[p] = p < planes ? linesize[p] : 0;
+        slot->rows[p] = p < planes ? rows[p] : 0;
+        slot->planeOffset[p] = p < planes ? planeOffset[p] : 0;
+    }
+    slot->primaries = color.primaries;
+    slot->transfer = color.transfer;
+    slot->matrix = color.matrix;
+
+    const auto data = reinterpret_cast<uint8_t *>(slot);
+    for (int p = 0; p < planes; p++)
+        av_image_copy_plane(data + planeOffset[p], linesize[p], frm->data[p], frm->linesize[p], rowBytes[p], rows[p]);
+
+    if (exif.size() > exifCapacity)
+        qWarning() << "Exif block of" << exif.size() << "bytes left out of the frame ring";
+    slot->exifOffset = exifOffset;
+    slot->exifSize = exif.size() <= exifCapacity ? exif.size() : 0;
+    memcpy(data + exifOffset, exif.data(), slot->exifSize);
+
+    slot->seq.store(2 * n + 2, std::memory_order_release);
+    hdr->published.store(n + 1, std::memory_order_release);
+
+    hdr->wakeup.fetch_add(1, std::memory_order_release);
+    FrameRing::wakeAll(&hdr->wakeup);
+
+    return true;
+}
+
+bool RingPublisher::create(const AVFrame *frm)
+{
+    const auto fmt = AVPixelFormat(frm->format);
+    const auto desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL)) ||
+        av_image_fill_linesizes(rowBytes, fmt, frm->width) < 0) {
+        qCritical() << "cannot publish pixel format" << frm->format;
+        return false;
+    }
+
+    // planes packed with cache line aligned rows, Exif behind them
+    planes = av_pix_fmt_count_planes(fmt);
+    uint64_t offset = alignUp(sizeof(FrameRing::SlotHeader), 64);
+    for (int p = 0; p < planes; p++) {
+        linesize[p] = alignUp(rowBytes[p], 64);
+        rows[p] = p == 1 || p == 2 ? AV_CEIL_RSHIFT(frm->height, desc->log2_chroma_h) : frm->height;
+        planeOffset[p] = offset;
+        offset += uint64_t(linesize[p]) * rows[p];
+    }
+    exifOffset = offset;
+
+    const auto slotBytes = alignUp(offset + exifCapacity, 4096);
+    const auto total = FrameRing::slotsOffset + slotCount * slotBytes;
+
+    const auto nm = shmName.toLocal8Bit();
+    const int fd = shm_open(nm.constData(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        qCritical() << "cannot create shared memory" << shmName << ":" << strerror(errno);
+        return false;
+    }
+
+    void *mem = MAP_FAILED;
+    if (ftruncate(fd, total) == 0)
+        mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mem == MAP_FAILED) {
+        qCritical() << "cannot map shared memory" << shmName << ":" << strerror(errno);
+        shm_unlink(nm.constData());
+        return false;
+    }
+
+    base = static_cast<uint8_t *>(mem);
+    mapped = total;
+    width = frm->width;
+    height = frm->height;
+    format = frm->format;
+
+    // fresh pages are zero, so counters and sequences start out at 0; magic last tells readers it is ready
+    const auto hdr = reinterpret_cast<FrameRing::RingHeader *>(base);
+    hdr->version = FrameRing::version;
+    hdr->slotCount = slotCount;
+    hdr->slotBytes = slotBytes;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr->magic = FrameRing::magic;
+
+    qInfo() << "publishing frames to shared memory" << shmName << "," << slotCount << "slots of" << slotBytes
+            << "bytes";
+    return true;
+}
+
+void RingPublisher::destroy()
+{
+    if (!base)
+        return;
+
+    // readers still mapping this ring learn to reopen it
+    const auto hdr = reinterpret_cast<FrameRing::RingHeader *>(base);
+    hdr->closed.store(1, std::memory_order_release);
+    hdr->wakeup.fetch_add(1, std::memory_order_release);
+    FrameRing::wakeAll(&hdr->wakeup);
+
+    munmap(base, mapped);
+    shm_unlink(shmName.toLocal8Bit().constData());
+
+    base = nullptr;
+    mapped = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef RINGPUBLISHER_H
+#define RINGPUBLISHER_H
+
+#include <mutex>
+#include <vector>
+#include <QString>
+#include "colorparams.h"
+#include "framering.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// publishes frames into a POSIX shared memory ring for local readers, see framering.h
+class RingPublisher
+{
+public:
+    explicit RingPublisher(const QString &name = FrameRing::defaultName, int slotCount = 8);
+    RingPublisher(const RingPublisher &) = delete;
+    ~RingPublisher();
+
+    const QString &name() const {return shmName;};
+
+    // copies frm into the next slot, overwriting the oldest frame; thread-safe
+    bool publish(const AVFrame *frm, AVRational timeBase, const ColorParams &color, const std::vector<uint8_t> &exif);
+
+protected:
+    // Exif room per slot, larger blocks are left out
+    static constexpr size_t exifCapacity = 64 * 1024;
+
+    QString shmName;
+    int slotCount;
+    std::mutex lock;
+
+    uint8_t *base;
+    size_t mapped;
+
+    // slot layout, made for the first frame and remade when frames change size or format
+    int width, height, format;
+    int planes, linesize[4], rowBytes[4], rows[4];
+    uint64_t planeOffset[4], exifOffset;
+
+    bool create(const AVFrame *frm);
+    void destroy();
+};
+
+#endif // RINGPUBLISHER_H
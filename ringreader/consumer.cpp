@@ -0,0 +1,54 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "ringreader.h"
+
+// prints the frames ViSIE publishes to shared memory, as a starting point for own readers
+//   visie-ring-consumer [name] [frames]
+int main(int argc, char *argv[])
+{
+    const std::string name = argc > 1 ? argv[1] : FrameRing::defaultName;
+    const long limit = argc > 2 ? strtol(argv[2], nullptr, 10) : 0;
+
+    RingReader reader;
+    long count = 0;
+    bool waiting = false;
+
+    while (!limit || count < limit) {
+        if (!reader.open(name)) {
+            if (!waiting)
+                fprintf(stderr, "waiting for %s\n", name.c_str());
+            waiting = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        waiting = false;
+
+        RingReader::Status status;
+        while ((status = reader.next(1000)) != RingReader::Status::Closed && (!limit || count < limit)) {
+            if (status != RingReader::Status::Frame)
+                continue;
+
+            // checksum of the first plane, read in place
+            const auto frm = reader.frame();
+            const auto luma = reader.plane(0);
+            uint32_t sum = 2166136261u;
+            for (int64_t i = 0; i < int64_t(frm->linesize[0]) * frm->rows[0]; i++)
+                sum = (sum ^ luma[i]) * 16777619u;
+
+            if (!reader.intact()) {
+                fprintf(stderr, "frame overwritten while reading\n");
+                continue;
+            }
+
+            printf("pts %lld (%d/%d) %dx%d format %d, %d planes, exif %u bytes, luma fnv %08x, %llu dropped\n",
+                   (long long) frm->pts, frm->timeBaseNum, frm->timeBaseDen, frm->width, frm->height, frm->format,
+                   frm->planes, frm->exifSize, sum, (unsigned long long) reader.dropped());
+            fflush(stdout);
+            count++;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "ringreader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RingReader::RingReader() : base(nullptr), mapped(0), hdr(nullptr), cur(nullptr), want(0), curIndex(0), lost(0)
+{
+}
+
+RingReader::~RingReader()
+{
+    close();
+}
+
+bool RingReader::open(const std::string &name)
+{
+    close();
+
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    void *mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= FrameRing::slotsOffset)
+        mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mem == MAP_FAILED)
+        return false;
+
+    base = mem;
+    mapped = st.st_size;
+    hdr = static_cast<FrameRing::RingHeader *>(base);
+
+    // the writer sets the magic once the ring is laid out
+    const auto ready = hdr->magic == FrameRing::magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!ready || hdr->version != FrameRing::version ||
+        FrameRing::slotsOffset + hdr->slotCount * hdr->slotBytes > mapped) {
+        close();
+        return false;
+    }
+
+    want = hdr->published.load(std::memory_order_acquire);
+    return true;
+}
+
+void RingReader::close()
+{
+    if (base)
+        munmap(base, mapped);
+
+    base = nullptr;
+    hdr = nullptr;
+    cur = nullptr;
+    mapped = 0;
+}
+
+RingReader::Status RingReader::next(int timeoutMs)
+{
+    cur = nullptr;
+    if (!hdr)
+        return Status::Closed;
+
+    while (true) {
+        // observe the futex word first so a publish in between still wakes us
+        const auto signal = hdr->wakeup.load(std::memory_order_acquire);
+        if (hdr->closed.load(std::memory_order_acquire))
+            return Status::Closed;
+
+        const auto published = hdr->published.load(std::memory_order_acquire);
+        if (want < published) {
+            // fallen behind by a whole ring, resume with the newest frame
+            if (published - want > hdr->slotCount) {
+                lost += published - 1 - want;
+                want = published - 1;
+            }
+
+            const auto slot = FrameRing::slotAt(base, hdr, want);
+            const auto seq = slot->seq.load(std::memory_order_acquire);
+            if (seq == 2 * want + 2) {
+                cur = slot;
+                curIndex = want++;
+                return Status::Frame;
+            }
+
+            // already being overwritten
+            lost++;
+            want++;
+            continue;
+        }
+
+        if (timeoutMs <= 0)
+            return Status::Timeout;
+
+        FrameRing::waitFor(&hdr->wakeup, signal, timeoutMs);
+        if (hdr->published.load(std::memory_order_acquire) == want && !hdr->closed.load(std::memory_order_acquire))
+            return Status::Timeout;
+    }
+}
+
+const uint8_t *RingReader::plane(int p) const
+{
+    if (!cur || p < 0 || p >= cur->planes)
+        return nullptr;
+
+    return reinterpret_cast<const uint8_t *>(cur) + cur->planeOffset[p];
+}
+
+const uint8_t *RingReader::exif() const
+{
+    if (!cur || !cur->exifSize)
+        return nullptr;
+
+    return reinterpret_cast<const uint8_t *>(cur) + cur->exifOffset;
+}
+
+bool RingReader::intact() const
+{
+    if (!cur)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return cur->seq.load(std::memory_order_relaxed) == 2 * curIndex + 2;
+}
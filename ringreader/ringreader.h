@@ -0,0 +1,47 @@
+#ifndef RINGREADER_H
+#define RINGREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "framering.h"
+
+// reads frames ViSIE publishes to shared memory, in place
+class RingReader
+{
+public:
+    enum class Status {
+        Frame,   // a frame is available through frame()
+        Timeout,
+        Closed   // the writer went away or replaced the ring, open() again
+    };
+
+    RingReader();
+    RingReader(const RingReader &) = delete;
+    ~RingReader();
+
+    // starts with the next frame published after opening
+    bool open(const std::string &name = FrameRing::defaultName);
+    void close();
+
+    Status next(int timeoutMs);
+
+    // valid after next() returned Frame, until the writer comes round to the slot again
+    const FrameRing::SlotHeader *frame() const {return cur;};
+    const uint8_t *plane(int p) const;
+    const uint8_t *exif() const;
+    // whether the frame was left alone by the writer while being read, check after using the data
+    bool intact() const;
+
+    // frames the writer overwrote before they could be read
+    uint64_t dropped() const {return lost;};
+
+protected:
+    void *base;
+    size_t mapped;
+    FrameRing::RingHeader *hdr;
+    const FrameRing::SlotHeader *cur;
+    uint64_t want, curIndex, lost;
+};
+
+#endif // RINGREADER_H
@@ -0,0 +1,102 @@
+#include "seekplanner.h"
+
+#include <QDebug>
+#include <algorithm>
+#include "tracer.h"
+
+SeekPlanner::SeekPlanner(FrameSource &src) : src(src), seekCount(0), groupCount(0)
+{
+}
+
+int SeekPlanner::run(std::vector<Request> requests, const Deliver &deliver)
+{
+    Tracer::Span span("SeekPlanner::run");
+    seekCount = groupCount = 0;
+    if (!src.isOpen() || requests.empty())
+        return 0;
+
+    // keyframes by time with their file offsets. Index times may be decode times, which only makes the grouping
+    // less tight: seeking and decoding on reach the right frame either way.
+    struct Key {
+        int64_t pts, pos;
+    };
+    std::vector<Key> keys;
+    const auto strm = src.videoStream();
+    for (int i = 0, n = avformat_index_get_entries_count(strm); i < n; i++) {
+        const auto entry = avformat_index_get_entry(strm, i);
+        if (entry->flags & AVINDEX_KEYFRAME)
+            keys.push_back({entry->timestamp, entry->pos});
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key &a, const Key &b) {
+        return a.pts < b.pts;
+    });
+
+    // the GOP of each request, frames before the first keyframe counting to the first GOP
+    const auto gopOf = [&keys](int64_t pts) {
+        const auto it = std::upper_bound(keys.begin(), keys.end(), pts, [](int64_t t, const Key &k) {
+            return t < k.pts;
+        });
+        return std::max(int(it - keys.begin()) - 1, 0);
+    };
+
+    struct Planned {
+        Request req;
+        int gop;
+        int64_t pos;
+    };
+    std::vector<Planned> plan;
+    for (const auto &req: requests) {
+        const auto gop = gopOf(req.pts);
+        const auto pos = keys.empty() || keys[gop].pos < 0 ? 0 : keys[gop].pos;
+        plan.push_back({req, gop, pos});
+    }
+    std::stable_sort(plan.begin(), plan.end(), [](const Planned &a, const Planned &b) {
+        if (a.pos != b.pos)
+            return a.pos < b.pos;
+        if (a.gop != b.gop)
+            return a.gop < b.gop;
+        return a.req.pts < b.req.pts;
+    });
+
+    const auto window = av_rescale_q(forwardSeconds, AVRational{1, 1}, strm->time_base);
+    auto frm = av_frame_alloc();
+    int delivered = 0, gop = -1;
+    bool positioned = false;
+
+    for (const auto &p: plan) {
+        const auto last = src.lastPts();
+        const auto ahead = positioned && last != AV_NOPTS_VALUE && p.req.pts >= last;
+
+        // the same GOP or the one right after it follows in the stream
+        bool onward;
+        if (keys.empty())
+            onward = ahead && p.req.pts - last <= window;
+        else
+            onward = ahead && (p.gop == gop || p.gop == gop + 1);
+
+        if (p.gop != gop)
+            groupCount++;
+        gop = p.gop;
+
+        bool found;
+        if (onward) {
+            found = src.advance(p.req.pts, frm);
+        }
+        else {
+            seekCount++;
+            found = src.seek(p.req.pts, frm);
+        }
+        positioned = found;
+
+        if (!found) {
+            qWarning() << "no frame at" << p.req.pts;
+            continue;
+        }
+
+        deliver(p.req.id, frm);
+        delivered++;
+    }
+
+    av_frame_free(&frm);
+    return delivered;
+}
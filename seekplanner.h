@@ -0,0 +1,40 @@
+#ifndef SEEKPLANNER_H
+#define SEEKPLANNER_H
+
+#include <functional>
+#include <vector>
+#include "framesource.h"
+
+// fetches frames at many time stamps of one file, ordered so each GOP is decoded once. Requests are grouped by
+// the keyframe before them in the demuxer's index and the groups visited in file order; requests within a group
+// and in directly following groups are reached by decoding on instead of seeking.
+class SeekPlanner
+{
+public:
+    struct Request {
+        int id;
+        int64_t pts; // in the video stream's time base
+    };
+
+    // the frame presented at the time of request id, owned by the planner and not to be changed; frames are
+    // delivered in file order, not request order
+    using Deliver = std::function<void(int id, AVFrame *frm)>;
+
+    explicit SeekPlanner(FrameSource &src);
+    SeekPlanner(const SeekPlanner &) = delete;
+
+    // returns the number of requests delivered
+    int run(std::vector<Request> requests, const Deliver &deliver);
+
+    int seeks() const {return seekCount;};
+    int groups() const {return groupCount;};
+
+protected:
+    // without an index, later frames within this distance are decoded on instead of seeking
+    static constexpr int forwardSeconds = 2;
+
+    FrameSource &src;
+    int seekCount, groupCount;
+};
+
+#endif // SEEKPLANNER_H
@@ -0,0 +1,173 @@
+#include "session.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include "framepool.h"
+#include "threadbudget.h"
+
+Session::Session(QObject *parent) : QObject(parent), current(0), shown(0), budget(defaultBudget),
+    width(0), height(0)
+{
+    videos.emplace_back();
+    videos.back().proc.reset(new VideoProcessor);
+}
+
+void Session::setDimensions(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    for (auto &video: videos)
+        video.proc->setDimensions(width, height);
+}
+
+void Session::setMemoryBudget(int64_t bytes)
+{
+    budget = bytes;
+    enforceBudget();
+}
+
+void Session::setRingExport(bool on)
+{
+    if (on == bool(ring))
+        return;
+
+    // the old ring is gone once no video refers to it, before a new one takes the name
+    if (!on) {
+        for (auto &video: videos)
+            video.proc->setRing(nullptr);
+    }
+#ifdef Q_OS_UNIX
+    ring.reset(on ? new RingPublisher : nullptr);
+#endif
+    for (auto &video: videos)
+        video.proc->setRing(ring);
+}
+
+VideoProcessor *Session::add()
+{
+    Video video;
+    video.proc.reset(new VideoProcessor);
+    video.proc->setDimensions(width, height);
+    video.proc->setRing(ring);
+
+    // an empty current video is taken instead
+    if (currentVideo()->file().isEmpty()) {
+        videos[current] = std::move(video);
+        emit activated(currentVideo(), nullptr);
+        return currentVideo();
+    }
+
+    videos.insert(videos.begin() + current + 1, std::move(video));
+    ThreadBudget::setVideos(count());
+    activate(current + 1);
+
+    return currentVideo();
+}
+
+void Session::removeCurrent()
+{
+    if (videos.size() == 1) {
+        currentVideo()->unload();
+        emit activated(currentVideo(), currentVideo());
+        return;
+    }
+
+    // switch away first so nothing refers to the processor anymore
+    const auto removed = current;
+    activate(current > 0 ? current - 1 : 1);
+    videos.erase(videos.begin() + removed);
+    ThreadBudget::setVideos(count());
+    if (current > removed)
+        current--;
+}
+
+void Session::activate(int index)
+{
+    if (index < 0 || index >= count())
+        return;
+
+    const auto previous = currentVideo();
+    const auto video = videos[index].proc.get();
+    if (video != previous)
+        previous->suspend();
+
+    current = index;
+    videos[index].lastShown = ++shown;
+    video->wake();
+    enforceBudget();
+
+    emit activated(video, previous);
+}
+
+void Session::setClockOffset(int index, double seconds)
+{
+    if (index >= 0 && index < count())
+        videos[index].clockOffset = seconds;
+}
+
+double Session::wallClock(int index, int64_t pts) const
+{
+    const auto &video = videos[index];
+    const auto created = video.proc->creationTime();
+    if (!created.isValid() || pts == AV_NOPTS_VALUE)
+        return NAN;
+
+    return created.toMSecsSinceEpoch() + video.clockOffset * 1000 +
+           av_q2d(video.proc->timeBase()) * (pts - video.proc->startTime()) * 1000;
+}
+
+int Session::syncToCurrent()
+{
+    const auto at = wallClock(current, currentVideo()->position());
+    if (std::isnan(at)) {
+        qWarning() << "recording time of the current video unknown";
+        return 0;
+    }
+
+    int synced = 0;
+    for (int i = 0; i < count(); i++) {
+        const auto start = wallClock(i, videos[i].proc->startTime());
+        if (i == current || std::isnan(start))
+            continue;
+
+        // skip videos that were not recording at that moment
+        const auto proc = videos[i].proc.get();
+        const auto pts = proc->startTime() + int64_t((at - start) / 1000 / av_q2d(proc->timeBase()));
+        if (pts < proc->startTime() || pts > proc->startTime() + proc->duration())
+            continue;
+
+        // decoded now, so switching over shows it right away
+        if (proc->wake()) {
+            proc->present(pts);
+            synced++;
+        }
+    }
+
+    enforceBudget();
+    return synced;
+}
+
+void Session::enforceBudget()
+{
+    if (FramePool::residentBytes() <= budget)
+        return;
+
+    // videos in the background close their decoders, least recently shown first
+    std::vector<Video *> idle;
+    for (int i = 0; i < count(); i++) {
+        if (i != current)
+            idle.push_back(&videos[i]);
+    }
+    std::sort(idle.begin(), idle.end(), [](const Video *a, const Video *b) {
+        return a->lastShown < b->lastShown;
+    });
+
+    for (auto video: idle) {
+        if (FramePool::residentBytes() <= budget)
+            break;
+
+        video->proc->hibernate();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <QObject>
+#include <memory>
+#include <vector>
+#include "videoprocessor.h"
+
+// several videos open at once, one of them shown. The others keep their index, metadata and last frame so
+// switching is instant; once the frame buffers of all exceed the memory budget, the least recently shown ones
+// close their decoders until shown again. Decoding and saving share the process-wide pool anyway.
+class Session : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int64_t defaultBudget = int64_t(1) << 30;
+
+    explicit Session(QObject *parent = nullptr);
+
+    int count() const {return int(videos.size());};
+    int currentIndex() const {return current;};
+    VideoProcessor *currentVideo() const {return videos[current].proc.get();};
+
+    void setDimensions(int width, int height);
+    // one shared memory ring for the saves of all videos, so they never resize a segment another one maps
+    void setRingExport(bool on);
+    bool ringExport() const {return bool(ring);};
+    void setMemoryBudget(int64_t bytes);
+
+    // an empty processor after the current one, made current
+    VideoProcessor *add();
+    // the one before becomes current; the last video is unloaded instead
+    void removeCurrent();
+    void activate(int index);
+
+    // corrects the clock of the camera a video was recorded with
+    void setClockOffset(int index, double seconds);
+    double clockOffset(int index) const {return videos[index].clockOffset;};
+    // shows in every other video the moment shown in the current one, returns how many were recording then
+    int syncToCurrent();
+
+signals:
+    void activated(VideoProcessor *video, VideoProcessor *previous);
+
+protected:
+    struct Video {
+        std::unique_ptr<VideoProcessor> proc;
+        double clockOffset = 0;
+        uint64_t lastShown = 0;
+    };
+
+    std::vector<Video> videos;
+    int current;
+    uint64_t shown;
+    int64_t budget;
+    int width, height;
+    std::shared_ptr<RingPublisher> ring;
+
+    // milliseconds since the epoch a position was recorded at, NaN if unknown
+    double wallClock(int index, int64_t pts) const;
+    void enforceBudget();
+};
+
+#endif // SESSION_H
@@ -0,0 +1,169 @@
+#include "sharpness.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SHARPNESS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SHARPNESS_NEON
+#include <arm_neon.h>
+#endif
+
+// 32 bit lane sums of squared 8 bit Laplacians stay exact for this many vectors
+static constexpr int flushInterval = 512;
+
+double Sharpness::laplacianVariance(const AVFrame *frm, const QRect &roi)
+{
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(frm->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE)))
+        return 0;
+
+    // the border has no full neighbourhood
+    QRect area(1, 1, frm->width - 2, frm->height - 2);
+    if (!roi.isNull())
+        area = area.intersected(roi);
+    if (area.width() <= 0 || area.height() <= 0)
+        return 0;
+
+    // luma interleaved with chroma (YUYV and the like) is not supported
+    const auto &luma = desc->comp[0];
+    if (luma.step != (luma.depth > 8 ? 2 : 1))
+        return 0;
+
+    const auto stride = frm->linesize[0];
+    Sums sums {0, 0, 0};
+
+    for (int y = area.top(); y <= area.bottom(); y++) {
+        const auto cur = frm->data[0] + ptrdiff_t(stride) * y + luma.offset;
+        if (luma.depth > 8) {
+            // 16 bit containers, possibly msb-aligned, scaled to 8 bit range
+            const auto shift = luma.shift + luma.depth - 8;
+            const auto c = reinterpret_cast<const uint16_t *>(cur) + area.left();
+            row16(c - stride / 2, c, c + stride / 2, area.width(), shift, sums);
+        }
+        else {
+            const auto c = cur + area.left();
+            row8(c - stride, c, c + stride, area.width(), sums);
+        }
+    }
+
+    const auto mean = double(sums.sum) / sums.count;
+    return double(sums.sumSq) / sums.count - mean * mean;
+}
+
+void Sharpness::row8(const uint8_t *up, const uint8_t *cur, const uint8_t *down, int n, Sums &sums)
+{
+    int i = 0;
+#if defined(SHARPNESS_SSE2)
+    const auto zero = _mm_setzero_si128();
+    const auto ones = _mm_set1_epi16(1);
+    const auto load = [&](const uint8_t *p) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), zero);
+    };
+
+    while (i + 8 <= n) {
+        auto sum = _mm_setzero_si128(), sumSq = _mm_setzero_si128();
+        for (int k = 0; k < flushInterval && i + 8 <= n; k++, i += 8) {
+            const auto lap = _mm_sub_epi16(_mm_slli_epi16(load(cur + i), 2),
+                                           _mm_add_epi16(_mm_add_epi16(load(cur + i - 1), load(cur + i + 1)),
+                                                         _mm_add_epi16(load(up + i), load(down + i))));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(lap, ones));
+            sumSq = _mm_add_epi32(sumSq, _mm_madd_epi16(lap, lap));
+        }
+
+        alignas(16) int32_t s[4], q[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(s), sum);
+        _mm_store_si128(reinterpret_cast<__m128i *>(q), sumSq);
+        sums.sum += int64_t(s[0]) + s[1] + s[2] + s[3];
+        sums.sumSq += int64_t(q[0]) + q[1] + q[2] + q[3];
+    }
+#elif defined(SHARPNESS_NEON)
+    const auto load = [](const uint8_t *p) {
+        return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+    };
+
+    while (i + 8 <= n) {
+        auto sum = vdupq_n_s32(0), sumSq = vdupq_n_s32(0);
+        for (int k = 0; k < flushInterval && i + 8 <= n; k++, i += 8) {
+            const auto lap = vsubq_s16(vshlq_n_s16(load(cur + i), 2),
+                                       vaddq_s16(vaddq_s16(load(cur + i - 1), load(cur + i + 1)),
+                                                 vaddq_s16(load(up + i), load(down + i))));
+            sum = vpadalq_s16(sum, lap);
+            sumSq = vmlal_s16(sumSq, vget_low_s16(lap), vget_low_s16(lap));
+            sumSq = vmlal_s16(sumSq, vget_high_s16(lap), vget_high_s16(lap));
+        }
+
+        sums.sum += vaddlvq_s32(sum);
+        sums.sumSq += vaddlvq_s32(sumSq);
+    }
+#endif
+    for (; i < n; i++) {
+        const int lap = 4 * cur[i] - cur[i - 1] - cur[i + 1] - up[i] - down[i];
+        sums.sum += lap;
+        sums.sumSq += lap * lap;
+    }
+
+    sums.count += n;
+}
+
+void Sharpness::row16(const uint16_t *up, const uint16_t *cur, const uint16_t *down, int n, int shift, Sums &sums)
+{
+    int i = 0;
+#if defined(SHARPNESS_SSE2)
+    const auto ones = _mm_set1_epi16(1);
+    const auto cnt = _mm_cvtsi32_si128(shift);
+    const auto load = [&](const uint16_t *p) {
+        return _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), cnt);
+    };
+
+    while (i + 8 <= n) {
+        auto sum = _mm_setzero_si128(), sumSq = _mm_setzero_si128();
+        for (int k = 0; k < flushInterval && i + 8 <= n; k++, i += 8) {
+            const auto lap = _mm_sub_epi16(_mm_slli_epi16(load(cur + i), 2),
+                                           _mm_add_epi16(_mm_add_epi16(load(cur + i - 1), load(cur + i + 1)),
+                                                         _mm_add_epi16(load(up + i), load(down + i))));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(lap, ones));
+            sumSq = _mm_add_epi32(sumSq, _mm_madd_epi16(lap, lap));
+        }
+
+        alignas(16) int32_t s[4], q[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(s), sum);
+        _mm_store_si128(reinterpret_cast<__m128i *>(q), sumSq);
+        sums.sum += int64_t(s[0]) + s[1] + s[2] + s[3];
+        sums.sumSq += int64_t(q[0]) + q[1] + q[2] + q[3];
+    }
+#elif defined(SHARPNESS_NEON)
+    const auto cnt = vdupq_n_s16(-shift);
+    const auto load = [&](const uint16_t *p) {
+        return vreinterpretq_s16_u16(vshlq_u16(vld1q_u16(p), cnt));
+    };
+
+    while (i + 8 <= n) {
+        auto sum = vdupq_n_s32(0), sumSq = vdupq_n_s32(0);
+        for (int k = 0; k < flushInterval && i + 8 <= n; k++, i += 8) {
+            const auto lap = vsubq_s16(vshlq_n_s16(load(cur + i), 2),
+                                       vaddq_s16(vaddq_s16(load(cur + i - 1), load(cur + i + 1)),
+                                                 vaddq_s16(load(up + i), load(down + i))));
+            sum = vpadalq_s16(sum, lap);
+            sumSq = vmlal_s16(sumSq, vget_low_s16(lap), vget_low_s16(lap));
+            sumSq = vmlal_s16(sumSq, vget_high_s16(lap), vget_high_s16(lap));
+        }
+
+        sums.sum += vaddlvq_s32(sum);
+        sums.sumSq += vaddlvq_s32(sumSq);
+    }
+#endif
+    for (; i < n; i++) {
+        const int lap = 4 * (cur[i] >> shift) - (cur[i - 1] >> shift) - (cur[i + 1] >> shift) -
+                        (up[i] >> shift) - (down[i] >> shift);
+        sums.sum += lap;
+        sums.sumSq += lap * lap;
+    }
+
+    sums.count += n;
+}
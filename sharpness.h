@@ -0,0 +1,26 @@
+#ifndef SHARPNESS_H
+#define SHARPNESS_H
+
+#include <QRect>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// focus measure over the luma plane, higher is sharper
+class Sharpness
+{
+public:
+    // variance of the 4-neighbour Laplacian, optionally within roi (frame coordinates), 0 for unsupported formats
+    static double laplacianVariance(const AVFrame *frm, const QRect &roi = QRect());
+
+protected:
+    struct Sums {
+        int64_t sum, sumSq, count;
+    };
+
+    static void row8(const uint8_t *up, const uint8_t *cur, const uint8_t *down, int n, Sums &sums);
+    static void row16(const uint16_t *up, const uint16_t *cur, const uint16_t *down, int n, int shift, Sums &sums);
+};
+
+#endif // SHARPNESS_H
@@ -0,0 +1,105 @@
+#include "stillness.h"
+
+#include <cmath>
+
+extern "C" {
+#include <libavutil/motion_vector.h>
+#include <libavutil/pixdesc.h>
+}
+
+Stillness::Stillness() : vectors(false)
+{
+}
+
+double Stillness::measure(const AVFrame *frm)
+{
+    auto motion = vectorMotion(frm);
+    if (motion >= 0) {
+        vectors = true;
+    }
+    else if (!vectors && prev) {
+        // no vectors seen so far, compare pixels instead
+        motion = lumaDifference(prev.get(), frm);
+    }
+
+    // intra frames of a stream with vectors stay unknown
+    if (!vectors) {
+        prev.reset(av_frame_clone(frm), [](AVFrame *f) {
+            av_frame_free(&f);
+        });
+    }
+    else {
+        prev.reset();
+    }
+
+    return motion;
+}
+
+void Stillness::reset()
+{
+    prev.reset();
+    vectors = false;
+}
+
+double Stillness::vectorMotion(const AVFrame *frm)
+{
+    const auto sd = av_frame_get_side_data(frm, AV_FRAME_DATA_MOTION_VECTORS);
+    if (!sd || sd->size < sizeof(AVMotionVector))
+        return -1;
+
+    const auto mvs = reinterpret_cast<const AVMotionVector *>(sd->data);
+    const auto n = sd->size / sizeof(AVMotionVector);
+
+    double sum = 0, area = 0;
+    for (size_t i = 0; i < n; i++) {
+        const auto &mv = mvs[i];
+        const double scale = mv.motion_scale ? mv.motion_scale : 1;
+        const double w = mv.w * mv.h;
+
+        sum += w * std::hypot(mv.motion_x / scale, mv.motion_y / scale);
+        area += w;
+    }
+
+    return area > 0 ? sum / area : -1;
+}
+
+double Stillness::lumaDifference(const AVFrame *a, const AVFrame *b)
+{
+    if (a->format != b->format || a->width != b->width || a->height != b->height)
+        return -1;
+
+    const auto desc = av_pix_fmt_desc_get(AVPixelFormat(a->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB)))
+        return -1;
+
+    // luma interleaved with chroma (YUYV and the like) is not supported
+    const auto &luma = desc->comp[0];
+    if (luma.step != (luma.depth > 8 ? 2 : 1))
+        return -1;
+
+    const auto wide = luma.depth > 8;
+    const auto shift = wide ? luma.shift + luma.depth - 8 : 0;
+
+    int64_t sum = 0, count = 0;
+    for (int y = 0; y < a->height; y += gridStep) {
+        const auto ra = a->data[0] + ptrdiff_t(a->linesize[0]) * y + luma.offset;
+        const auto rb = b->data[0] + ptrdiff_t(b->linesize[0]) * y + luma.offset;
+
+        for (int x = 0; x < a->width; x += gridStep) {
+            int va, vb;
+            if (wide) {
+                va = reinterpret_cast<const uint16_t *>(ra)[x] >> shift;
+                vb = reinterpret_cast<const uint16_t *>(rb)[x] >> shift;
+            }
+            else {
+                va = ra[x];
+                vb = rb[x];
+            }
+
+            sum += std::abs(va - vb);
+            count++;
+        }
+    }
+
+    return count ? double(sum) / count : -1;
+}
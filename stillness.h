@@ -0,0 +1,33 @@
+#ifndef STILLNESS_H
+#define STILLNESS_H
+
+#include <memory>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// global motion of consecutive frames, lower is stiller
+class Stillness
+{
+public:
+    Stillness();
+
+    // motion of frm relative to the frame measured before, negative if unknown
+    double measure(const AVFrame *frm);
+    void reset();
+
+    // area-weighted mean motion vector length in pixels, negative without exported vectors
+    static double vectorMotion(const AVFrame *frm);
+    // mean absolute luma difference on a sparse grid, for decoders that cannot export vectors
+    static double lumaDifference(const AVFrame *a, const AVFrame *b);
+
+protected:
+    // lumaDifference() samples every gridStep-th pixel of every gridStep-th row
+    static constexpr int gridStep = 8;
+
+    std::shared_ptr<AVFrame> prev;
+    bool vectors;
+};
+
+#endif // STILLNESS_H
@@ -0,0 +1,288 @@
+#include "streamwriter.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "framesource.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+StreamWriter::StreamWriter(Format format, const QString &sidecar) : format(format), sidecar(sidecar), fd(-1)
+{
+    width = height = planes = 0;
+    pixFmt = AV_PIX_FMT_NONE;
+    frameRate = timeBase = AVRational{0, 1};
+}
+
+StreamWriter::~StreamWriter()
+{
+    if (fd < 0)
+        return;
+
+    if (format == Format::Raw && !sidecar.isEmpty())
+        writeSidecar();
+
+    if (fd != STDOUT_FILENO)
+        ::close(fd);
+}
+
+void StreamWriter::setSource(const QString &fileName, AVRational frameRate, AVRational timeBase)
+{
+    source = fileName;
+    this->frameRate = frameRate;
+    this->timeBase = timeBase;
+}
+
+bool StreamWriter::save(AVFrame *frm, QString fileName, std::future<void> &, QString &, ColorParams &, ExifData &,
+                        const QRect &crop)
+{
+    const auto view = cropped(frm, crop);
+    if (!view)
+        return false;
+    frm = view.get();
+
+    if (pixFmt == AV_PIX_FMT_NONE && !open(fileName, frm))
+        return false;
+
+    if (frm->width != width || frm->height != height || frm->format != pixFmt) {
+        qCritical() << "frame layout changed within the stream to" << target;
+        return false;
+    }
+
+    // straight from the frame's planes, rows of contiguous planes in one go
+    static const char frameHeader[] = "FRAME\n";
+    std::vector<iovec> bufs;
+    if (format == Format::Y4M)
+        bufs.push_back(iovec {const_cast<char *>(frameHeader), sizeof(frameHeader) - 1});
+
+    for (int p = 0; p < planes; p++) {
+        if (frm->linesize[p] == rowBytes[p]) {
+            bufs.push_back(iovec {frm->data[p], size_t(rowBytes[p]) * rows[p]});
+            continue;
+        }
+
+        for (int y = 0; y < rows[p]; y++)
+            bufs.push_back(iovec {frm->data[p] + ptrdiff_t(frm->linesize[p]) * y, size_t(rowBytes[p])});
+    }
+
+    if (!writeAll(bufs))
+        return false;
+
+    const auto pts = FrameSource::ptsOf(frm);
+    const auto ms = timeBase.num && pts != AV_NOPTS_VALUE ? av_rescale_q(pts, timeBase, AVRational{1, 1000}) : -1;
+    written.push_back(Entry {source, pts, ms});
+
+    return true;
+}
+
+bool StreamWriter::open(const QString &fileName, const AVFrame *frm)
+{
+    const auto fmt = AVPixelFormat(frm->format);
+    const auto desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+        qCritical() << "cannot stream pixel format" << frm->format;
+        return false;
+    }
+
+    QByteArray header;
+    if (format == Format::Y4M) {
+        header = y4mHeader(frm);
+        if (header.isEmpty()) {
+            qCritical() << "Y4M has no layout for" << desc->name << "frames, use a raw stream";
+            return false;
+        }
+    }
+
+    if (av_image_fill_linesizes(rowBytes, fmt, frm->width) < 0)
+        return false;
+
+    planes = av_pix_fmt_count_planes(fmt);
+    for (int p = 0; p < planes; p++)
+        rows[p] = p == 1 || p == 2 ? AV_CEIL_RSHIFT(frm->height, desc->log2_chroma_h) : frm->height;
+
+    if (buffer) {
+        // no file
+    }
+    else if (fileName == "-") {
+        fd = STDOUT_FILENO;
+    }
+    else {
+        fd = ::open(fileName.toLocal8Bit().constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            qCritical() << "cannot open" << fileName << ":" << strerror(errno);
+            return false;
+        }
+    }
+
+    target = fileName;
+    width = frm->width;
+    height = frm->height;
+    pixFmt = frm->format;
+
+    // what a reader needs to slice the raw stream
+    QJsonArray planeList;
+    int64_t offset = 0;
+    for (int p = 0; p < planes; p++) {
+        planeList.append(QJsonObject {{"offset", qint64(offset)}, {"row_bytes", rowBytes[p]}, {"rows", rows[p]}});
+        offset += int64_t(rowBytes[p]) * rows[p];
+    }
+
+    layout = QJsonObject {
+        {"pixel_format", desc->name},
+        {"width", width},
+        {"height", height},
+        {"frame_bytes", qint64(offset)},
+        {"planes", planeList},
+        {"color_range", av_color_range_name(frm->color_range)},
+        {"color_primaries", av_color_primaries_name(frm->color_primaries)},
+        {"color_trc", av_color_transfer_name(frm->color_trc)},
+        {"colorspace", av_color_space_name(frm->colorspace)},
+        {"chroma_location", av_chroma_location_name(frm->chroma_location)}
+    };
+
+    if (header.isEmpty())
+        return true;
+
+    std::vector<iovec> bufs {iovec {header.data(), size_t(header.size())}};
+    return writeAll(bufs);
+}
+
+QByteArray StreamWriter::y4mHeader(const AVFrame *frm) const
+{
+    QByteArray cs;
+    switch (frm->format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            if (frm->chroma_location == AVCHROMA_LOC_LEFT)
+                cs = "420mpeg2";
+            else if (frm->chroma_location == AVCHROMA_LOC_TOPLEFT)
+                cs = "420paldv";
+            else
+                cs = "420jpeg";
+            break;
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+            cs = "422";
+            break;
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+            cs = "444";
+            break;
+        case AV_PIX_FMT_GRAY8:
+            cs = "mono";
+            break;
+        case AV_PIX_FMT_YUV420P10LE:
+            cs = "420p10 XYSCSS=420P10";
+            break;
+        case AV_PIX_FMT_YUV422P10LE:
+            cs = "422p10 XYSCSS=422P10";
+            break;
+        case AV_PIX_FMT_YUV444P10LE:
+            cs = "444p10 XYSCSS=444P10";
+            break;
+        case AV_PIX_FMT_YUV420P12LE:
+            cs = "420p12 XYSCSS=420P12";
+            break;
+        case AV_PIX_FMT_YUV422P12LE:
+            cs = "422p12 XYSCSS=422P12";
+            break;
+        case AV_PIX_FMT_YUV444P12LE:
+            cs = "444p12 XYSCSS=444P12";
+            break;
+        default:
+            return QByteArray();
+    }
+
+#ifdef AV_FRAME_FLAG_INTERLACED
+    const bool interlaced = frm->flags & AV_FRAME_FLAG_INTERLACED;
+    const bool topFirst = frm->flags & AV_FRAME_FLAG_TOP_FIELD_FIRST;
+#else
+    const bool interlaced = frm->interlaced_frame;
+    const bool topFirst = frm->top_field_first;
+#endif
+
+    // selected frames are not evenly spaced, the rate is the source's nominal one
+    const auto rate = frameRate.num > 0 && frameRate.den > 0 ? frameRate : AVRational{25, 1};
+    const auto sar = frm->sample_aspect_ratio;
+
+    auto header = QString("YUV4MPEG2 W%1 H%2 F%3:%4 I%5 A%6:%7 C")
+                      .arg(frm->width).arg(frm->height).arg(rate.num).arg(rate.den)
+                      .arg(interlaced ? (topFirst ? 't' : 'b') : 'p')
+                      .arg(sar.num > 0 ? sar.num : 0).arg(sar.num > 0 ? sar.den : 0)
+                      .toLatin1() + cs;
+
+    if (frm->color_range == AVCOL_RANGE_JPEG || frm->format == AV_PIX_FMT_YUVJ420P ||
+        frm->format == AV_PIX_FMT_YUVJ422P || frm->format == AV_PIX_FMT_YUVJ444P)
+        header += " XCOLORRANGE=FULL";
+    else if (frm->color_range == AVCOL_RANGE_MPEG)
+        header += " XCOLORRANGE=LIMITED";
+
+    return header + "\n";
+}
+
+bool StreamWriter::writeAll(std::vector<iovec> &bufs)
+{
+    if (buffer) {
+        for (const auto &buf: bufs)
+            buffer->append(static_cast<const char *>(buf.iov_base), int(buf.iov_len));
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < bufs.size()) {
+        const auto n = std::min(bufs.size() - i, size_t(maxBuffers));
+        const auto done = ::writev(fd, bufs.data() + i, int(n));
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+
+            qCritical() << "writing to" << target << "failed:" << strerror(errno);
+            return false;
+        }
+
+        // a short write resumes within the buffer it stopped in
+        auto left = size_t(done);
+        while (i < bufs.size() && left >= bufs[i].iov_len) {
+            left -= bufs[i].iov_len;
+            i++;
+        }
+        if (left) {
+            bufs[i].iov_base = static_cast<char *>(bufs[i].iov_base) + left;
+            bufs[i].iov_len -= left;
+        }
+    }
+
+    return true;
+}
+
+bool StreamWriter::writeSidecar()
+{
+    QJsonArray frames;
+    for (const auto &entry: written) {
+        frames.append(QJsonObject {{"source", entry.source}, {"pts", qint64(entry.pts)},
+                                   {"time_ms", qint64(entry.ms)}});
+    }
+
+    auto root = layout;
+    root["stream"] = target;
+    root["frames"] = frames;
+
+    QFile file(sidecar);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "cannot write" << sidecar;
+        return false;
+    }
+
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef STREAMWRITER_H
+#define STREAMWRITER_H
+
+#include <vector>
+#include <QByteArray>
+#include <QJsonObject>
+#include "filewriter.h"
+
+struct iovec;
+
+// appends frames as they are decoded to one Y4M or raw stream, for piping into other tools
+class StreamWriter : public FileWriter
+{
+public:
+    enum class Format {
+        Y4M,
+        Raw // planes back to back, described by a JSON sidecar
+    };
+
+    // sidecar is the JSON file written on destruction, raw streams only
+    explicit StreamWriter(Format format, const QString &sidecar = QString());
+    StreamWriter(const StreamWriter &) = delete;
+    ~StreamWriter();
+
+    // origin of the frames saved next, for the stream header and the sidecar
+    void setSource(const QString &fileName, AVRational frameRate, AVRational timeBase);
+
+    // appends frm to the stream at fileName, "-" for standard output; the first save opens it and fixes the layout
+    bool save(AVFrame *frm, QString fileName, std::future<void> &metaDataReady, QString &iccFileName,
+              ColorParams &colr, ExifData &exifData, const QRect &crop = QRect());
+
+protected:
+    // writev() takes this many buffers per call at most
+    static constexpr int maxBuffers = 1024;
+
+    Format format;
+    QString sidecar, target;
+    int fd;
+
+    // layout of the stream, fixed by the first frame
+    int width, height, pixFmt;
+    int planes, rowBytes[4], rows[4];
+    QJsonObject layout;
+
+    QString source;
+    AVRational frameRate, timeBase;
+
+    struct Entry {
+        QString source;
+        int64_t pts, ms;
+    };
+    std::vector<Entry> written;
+
+    bool open(const QString &fileName, const AVFrame *frm);
+    QByteArray y4mHeader(const AVFrame *frm) const;
+    bool writeAll(std::vector<iovec> &bufs);
+    bool writeSidecar();
+};
+
+#endif // STREAMWRITER_H
@@ -0,0 +1,50 @@
+#include "subtitlereader.h"
+
+#include <QDebug>
+
+SubtitleReader::SubtitleReader() : strm(-1), codecCtx(nullptr)
+{
+}
+
+SubtitleReader::~SubtitleReader()
+{
+    close();
+}
+
+void SubtitleReader::open(AVFormatContext *ctx)
+{
+    close();
+
+    const AVCodec *subCodec = nullptr;
+    strm = av_find_best_stream(ctx, AVMEDIA_TYPE_SUBTITLE, -1, -1, &subCodec, 0);
+    if (strm > 0) {
+        codecCtx = avcodec_alloc_context3(subCodec);
+        avcodec_parameters_to_context(codecCtx, ctx->streams[strm]->codecpar);
+
+        if (avcodec_open2(codecCtx, subCodec, nullptr) < 0)
+            qDebug() << QString("cannot open sub codec %1").arg(subCodec->long_name);
+    }
+}
+
+void SubtitleReader::close()
+{
+    if (codecCtx)
+        avcodec_free_context(&codecCtx);
+    strm = -1;
+    current.clear();
+}
+
+void SubtitleReader::feed(AVPacket *pkt)
+{
+    if (pkt->stream_index != strm || !codecCtx)
+        return;
+
+    AVSubtitle sub;
+    int gotSub;
+
+    auto len = avcodec_decode_subtitle2(codecCtx, &sub, &gotSub, pkt);
+    if (len > 0 && gotSub && sub.num_rects > 0) {
+        current = sub.rects[0]->ass;
+        avsubtitle_free(&sub);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef SUBTITLEREADER_H
+#define SUBTITLEREADER_H
+
+#include <QString>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+// decodes the best subtitle stream of a file alongside the video, DJI drones store metadata there
+class SubtitleReader
+{
+public:
+    SubtitleReader();
+    SubtitleReader(const SubtitleReader &) = delete;
+    ~SubtitleReader();
+
+    void open(AVFormatContext *ctx);
+    void close();
+
+    void feed(AVPacket *pkt);
+    const QString &text() const {return current;};
+
+protected:
+    int strm;
+    AVCodecContext *codecCtx;
+    QString current;
+};
+
+#endif // SUBTITLEREADER_H
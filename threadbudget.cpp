@@ -0,0 +1,89 @@
+#include "threadbudget.h"
+
+#include <QtGlobal>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+std::atomic<int> budget {0};
+std::atomic<int> videos {1};
+
+// decoding half of one open video
+int videoShare()
+{
+    return qMax(ThreadBudget::decoder() / videos.load(std::memory_order_relaxed), 1);
+}
+
+}
+
+int ThreadBudget::total()
+{
+    auto n = budget.load(std::memory_order_relaxed);
+    if (n > 0)
+        return n;
+
+    n = qEnvironmentVariableIntValue("VISIE_THREADS");
+    if (n <= 0)
+        n = int(std::thread::hardware_concurrency());
+
+    n = qMax(n, 1);
+    budget.store(n, std::memory_order_relaxed);
+    return n;
+}
+
+void ThreadBudget::setTotal(int threads)
+{
+    budget.store(qMax(threads, 1), std::memory_order_relaxed);
+}
+
+int ThreadBudget::pool()
+{
+    // saves and background jobs each get a worker even on small machines, and one stays over
+    return qMax(total() / 2, 3);
+}
+
+int ThreadBudget::saves()
+{
+    // half the pool, with background() below the other half, so display and interactive work always finds a free
+    // worker
+    return qMax(pool() / 2, 1);
+}
+
+int ThreadBudget::background()
+{
+    return qMax(pool() / 4, 1);
+}
+
+int ThreadBudget::decoder()
+{
+    return qMax(total() / 2, 1);
+}
+
+void ThreadBudget::setVideos(int count)
+{
+    videos.store(qMax(count, 1), std::memory_order_relaxed);
+}
+
+int ThreadBudget::shown()
+{
+    return qMax(videoShare() / 2, 1);
+}
+
+int ThreadBudget::prefetcher()
+{
+    // runs next to the shown decoder while stepping
+    return qMax(videoShare() / 4, 1);
+}
+
+int ThreadBudget::player()
+{
+    // stepping and prefetching pause during playback
+    return qMax(videoShare() / 2, 1);
+}
+
+int ThreadBudget::encoder()
+{
+    // the saves running at once split the pool's half between them
+    return qMax(pool() / saves(), 1);
+}
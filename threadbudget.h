@@ -0,0 +1,36 @@
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+
+// one budget of threads for the shared pool and the threads libraries start themselves (libavcodec, x265,
+// openjpeg), so overlapping decodes and saves do not oversubscribe the machine. Half of it goes to decoding, the
+// other half to the pool, whose saves share it with their encoders. The videos open in the window split the
+// decoding half, and within a video the decoder stepping through it shares with the prefetcher, while playback
+// takes over from both.
+class ThreadBudget
+{
+public:
+    // the core count unless VISIE_THREADS or setTotal() say otherwise
+    static int total();
+    // takes effect for the shared pool only before its first use
+    static void setTotal(int threads);
+
+    // at least three workers, so the capped saves and background jobs leave one over
+    static int pool();
+    // saves running at once on the pool
+    static int saves();
+    // background jobs running at once on the pool
+    static int background();
+    // libavcodec threads of one decoder running alone
+    static int decoder();
+
+    // videos open in the window at once
+    static void setVideos(int count);
+    // libavcodec threads of the decoders of one open video: seeking and stepping, prefetching and playback
+    static int shown();
+    static int prefetcher();
+    static int player();
+    // x265 or openjpeg threads of one encode
+    static int encoder();
+};
+
+#endif // THREADBUDGET_H
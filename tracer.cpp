@@ -0,0 +1,199 @@
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char *name;
+    char detail[16];
+    int64_t start, duration; // ns
+};
+
+// written by one thread at a time, the oldest events are overwritten once full
+struct Buffer {
+    static constexpr uint64_t capacity = 1 << 14;
+
+    int tid;
+    std::atomic<bool> inUse {true};
+    std::atomic<uint64_t> written {0};
+    Event events[capacity];
+    // per slot the number of the event it holds plus one, 0 while it is being written
+    std::atomic<uint64_t> seqs[capacity] {};
+};
+
+// buffers outlive their threads so short-lived workers still show up, and are handed to the next new thread
+std::mutex registryMtx;
+std::vector<std::unique_ptr<Buffer>> registry;
+
+std::atomic<int64_t> startedAt {0};
+QString exitFileName;
+
+struct Local {
+    Buffer *buf = nullptr;
+
+    ~Local()
+    {
+        if (buf)
+            buf->inUse.store(false, std::memory_order_release);
+    }
+};
+thread_local Local local;
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Buffer *threadBuffer()
+{
+    if (local.buf)
+        return local.buf;
+
+    std::lock_guard<std::mutex> lock(registryMtx);
+    for (const auto &buf: registry) {
+        bool idle = false;
+        if (buf->inUse.compare_exchange_strong(idle, true, std::memory_order_acquire))
+            return local.buf = buf.get();
+    }
+
+    registry.emplace_back(new Buffer);
+    registry.back()->tid = int(registry.size());
+    return local.buf = registry.back().get();
+}
+
+void dumpOnExit()
+{
+    Tracer::dump(exitFileName);
+}
+
+}
+
+void Tracer::Span::begin(const char *detail)
+{
+    if (detail)
+        strncpy(this->detail, detail, sizeof(this->detail) - 1);
+    else
+        this->detail[0] = 0;
+    this->detail[sizeof(this->detail) - 1] = 0;
+
+    start = now();
+}
+
+void Tracer::Span::end()
+{
+    const auto finish = now();
+    const auto buf = threadBuffer();
+    const auto n = buf->written.load(std::memory_order_relaxed);
+
+    const auto slot = n % Buffer::capacity;
+    buf->seqs[slot].store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto &ev = buf->events[slot];
+    ev.name = name;
+    memcpy(ev.detail, detail, sizeof(detail));
+    ev.start = start;
+    ev.duration = finish - start;
+
+    buf->seqs[slot].store(n + 1, std::memory_order_release);
+    buf->written.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::start()
+{
+    startedAt.store(now(), std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::stop()
+{
+    enabled.store(false, std::memory_order_release);
+}
+
+bool Tracer::dump(const QString &fileName)
+{
+    std::vector<Buffer *> bufs;
+    {
+        std::lock_guard<std::mutex> lock(registryMtx);
+        for (const auto &buf: registry)
+            bufs.push_back(buf.get());
+    }
+
+    const auto since = startedAt.load(std::memory_order_relaxed);
+    const auto pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    for (const auto buf: bufs) {
+        // copy without stopping the writer, keeping a slot only if it held the same event before and after
+        const auto end = buf->written.load(std::memory_order_acquire);
+        const auto begin = end > Buffer::capacity ? end - Buffer::capacity : 0;
+        std::vector<std::pair<uint64_t, Event>> copy;
+        copy.reserve(end - begin);
+        for (auto i = begin; i < end; i++) {
+            const auto slot = i % Buffer::capacity;
+            const auto seq = buf->seqs[slot].load(std::memory_order_acquire);
+            const auto ev = buf->events[slot];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq == i + 1 && buf->seqs[slot].load(std::memory_order_relaxed) == seq)
+                copy.emplace_back(i, ev);
+        }
+
+        // the writer may be filling the slot of event 'after' already, which also held the oldest one
+        const auto after = buf->written.load(std::memory_order_acquire);
+        const auto valid = after + 1 > Buffer::capacity ? after + 1 - Buffer::capacity : 0;
+
+        for (const auto &[i, ev]: copy) {
+            if (i < valid || ev.start < since)
+                continue;
+
+            QJsonObject obj {
+                {"name", ev.name},
+                {"cat", "visie"},
+                {"ph", "X"},
+                {"ts", double(ev.start) / 1000},
+                {"dur", double(ev.duration) / 1000},
+                {"pid", qint64(pid)},
+                {"tid", buf->tid}
+            };
+            if (ev.detail[0])
+                obj["args"] = QJsonObject {{"detail", QString::fromLatin1(ev.detail)}};
+
+            events.append(obj);
+        }
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "cannot write trace" << fileName;
+        return false;
+    }
+
+    file.write(QJsonDocument(QJsonObject {{"traceEvents", events}, {"displayTimeUnit", "ms"}}).toJson(
+        QJsonDocument::Compact));
+    qInfo() << events.size() << "trace events written to" << fileName;
+
+    return true;
+}
+
+void Tracer::dumpAtExit(const QString &fileName)
+{
+    if (exitFileName.isEmpty())
+        atexit(dumpOnExit);
+
+    exitFileName = fileName;
+    start();
+}
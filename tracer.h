@@ -0,0 +1,52 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <QString>
+
+// timed spans of the hot paths, kept in per-thread buffers and written out as Chrome trace_event JSON for Perfetto
+// or chrome://tracing; a stopped tracer costs one relaxed load per span
+class Tracer
+{
+public:
+    // records its lifetime under name, detail (up to 15 characters) goes into the event's args
+    class Span
+    {
+    public:
+        explicit Span(const char *name, const char *detail = nullptr)
+        {
+            this->name = enabled.load(std::memory_order_relaxed) ? name : nullptr;
+            if (this->name)
+                begin(detail);
+        }
+        ~Span()
+        {
+            if (name)
+                end();
+        }
+        Span(const Span &) = delete;
+
+    protected:
+        const char *name;
+        char detail[16];
+        int64_t start;
+
+        void begin(const char *detail);
+        void end();
+    };
+
+    // spans before start() are left out of dumps
+    static void start();
+    static void stop();
+    static bool isRunning() {return enabled.load(std::memory_order_relaxed);}
+
+    static bool dump(const QString &fileName);
+    // starts tracing and dumps when the process exits
+    static void dumpAtExit(const QString &fileName);
+
+protected:
+    static inline std::atomic<bool> enabled {false};
+};
+
+#endif // TRACER_H
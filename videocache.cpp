@@ -0,0 +1,70 @@
+#include "videocache.h"
+
+#include <QDebug>
+#include <vector>
+
+VideoCache::Video::Video(const QString &fileName, int worker) :
+    fileName(fileName), worker(worker), meta(nullptr)
+{
+    frame = av_frame_alloc();
+    src.packetHook = [this](AVPacket *pkt) {
+        subs.feed(pkt);
+    };
+}
+
+VideoCache::Video::~Video()
+{
+    if (meta)
+        avio_closep(&meta);
+    av_frame_free(&frame);
+}
+
+void VideoCache::Video::open()
+{
+    src.open(fileName);
+    subs.open(src.formatContext());
+
+    // metadata is read through its own context, the demuxer's position must not move
+    if (avio_open(&meta, fileName.toLocal8Bit(), AVIO_FLAG_READ) < 0) {
+        meta = nullptr;
+        qWarning() << "no metadata access to" << fileName;
+    }
+}
+
+VideoCache::VideoCache(size_t capacity, int workers) : capacity(qMax<size_t>(capacity, 1)), workers(qMax(workers, 1))
+{
+}
+
+std::shared_ptr<VideoCache::Video> VideoCache::acquire(const QString &fileName)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (auto it = lru.begin(); it != lru.end(); it++) {
+        if ((*it)->fileName == fileName) {
+            lru.splice(lru.begin(), lru, it);
+            return lru.front();
+        }
+    }
+
+    // evicted entries close once their pending requests are through
+    while (lru.size() >= capacity)
+        lru.pop_back();
+
+    std::vector<int> count(workers, 0);
+    for (const auto &video: lru)
+        count[video->worker]++;
+    int worker = 0;
+    for (int w = 1; w < workers; w++) {
+        if (count[w] < count[worker])
+            worker = w;
+    }
+
+    lru.emplace_front(new Video(fileName, worker));
+    return lru.front();
+}
+
+void VideoCache::drop(const std::shared_ptr<Video> &video)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    lru.remove(video);
+}
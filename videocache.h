@@ -0,0 +1,49 @@
+#ifndef VIDEOCACHE_H
+#define VIDEOCACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <QString>
+#include "framesource.h"
+#include "subtitlereader.h"
+
+// videos kept open between requests, least recently used ones closed beyond capacity
+class VideoCache
+{
+public:
+    // demuxer, decoder with its index, subtitles and metadata I/O of one file; used by its worker thread only
+    struct Video {
+        QString fileName;
+        int worker;
+
+        FrameSource src;
+        SubtitleReader subs;
+        AVIOContext *meta;
+        AVFrame *frame; // returned last
+
+        Video(const QString &fileName, int worker);
+        Video(const Video &) = delete;
+        ~Video();
+
+        // throws QString like FrameSource::open()
+        void open();
+        bool isOpen() const {return src.isOpen();};
+    };
+
+    VideoCache(size_t capacity, int workers);
+    VideoCache(const VideoCache &) = delete;
+
+    // the entry of fileName, created on first use and bound to the worker with the fewest entries
+    std::shared_ptr<Video> acquire(const QString &fileName);
+    // forget an entry that could not be opened, so the next request tries again
+    void drop(const std::shared_ptr<Video> &video);
+
+protected:
+    size_t capacity;
+    std::mutex mtx;
+    int workers;
+    std::list<std::shared_ptr<Video>> lru; // most recent first
+};
+
+#endif // VIDEOCACHE_H
@@ -2,9 +2,11 @@
 
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QStandardPaths>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
+#include <chrono>
 #include <memory>
 #include <future>
 #include <libheif/heif.h>
@@ -12,22 +14,69 @@
 #include "scopedresource.h"
 #include "mediareader.h"
 #include "heifwriter.h"
+#include "framepicker.h"
+#include "framestacker.h"
+#include "jobscheduler.h"
+#include "sharpness.h"
+#include "stillness.h"
+#include "threadbudget.h"
+#include "tracer.h"
+
+// reference to the buffers of a decoded frame, no copy
+static std::shared_ptr<AVFrame> holdFrame(const AVFrame *frm)
+{
+    return std::shared_ptr<AVFrame>(av_frame_clone(frm), [](AVFrame *f) {
+        av_frame_free(&f);
+    });
+}
 
 VideoProcessor::VideoProcessor(QObject *parent) : QObject(parent)
 {
-    ctx = nullptr;
     cnvCtx = nullptr;
-    codecCtx = nullptr;
     width = height = 0;
+    stepPrev = false;
+    nextSurface = 0;
+    motionScan = qEnvironmentVariable("VISIE_MOTION_SCAN") != "0";
 
     frmBuf[0].frm = nullptr;
     frmBuf[1].frm = nullptr;
     frmBuf[0].other = &frmBuf[1];
     frmBuf[1].other = &frmBuf[0];
+    curFrm = &frmBuf[0];
+
+    src.packetHook = [this](AVPacket *pkt) {
+        subs.feed(pkt);
+    };
+
+    fileSize = length = srcLength = 0;
+    streamTimeBase = {1, 1};
+    startPts = 0;
+
+    // the watcher uses inotify where available, polling covers network mounts
+    growthTimer.setInterval(1000);
+    connect(&growthTimer, &QTimer::timeout, this, &VideoProcessor::fileGrown);
+    connect(&growthWatcher, &QFileSystemWatcher::fileChanged, this, &VideoProcessor::fileGrown);
+
+    playStart = 0;
+    playSpeed = 1;
+    playTimer.setTimerType(Qt::PreciseTimer);
+    connect(&playTimer, &QTimer::timeout, this, &VideoProcessor::playbackTick);
+
+    // release file names once their save completed
+    connect(this, &VideoProcessor::frameSaved, this, [this](QString fileName, bool success) {
+        reserved.remove(fileName);
+
+        counters.add(Metrics::SavesInFlight, -1);
+        if (!success)
+            counters.add(Metrics::SavesFailed);
+    });
 }
 
 VideoProcessor::~VideoProcessor()
 {
+    for (auto &save: saves)
+        save.wait();
+
     cleanup();
 }
 
@@ -37,9 +86,6 @@ void VideoProcessor::setDimensions(int width, int height)
         sws_freeContext(cnvCtx);
         cnvCtx = nullptr;
 
-        av_frame_free(&frmBuf[0].frm);
-        av_frame_free(&frmBuf[1].frm);
-
         this->width = width;
         this->height = height;
     }
@@ -47,65 +93,62 @@ void VideoProcessor::setDimensions(int width, int height)
 
 void VideoProcessor::loadVideo(QString fn)
 {
+    Tracer::Span span("loadVideo");
     cleanup();
-    ctx = avformat_alloc_context();
 
+    loadClock.start();
     try {
-        const AVCodec *videoCodec;
-
-        // open file
-        if (avformat_open_input(&ctx, fn.toLocal8Bit(), NULL, NULL) != 0)
-            throw QString("Cannot open file");
-
-        // access video stream
-        if (avformat_find_stream_info(ctx, NULL) < 0)
-            throw QString("Cannot read video stream info");
-
-        videoStrm = av_find_best_stream(ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &videoCodec, 0);
-        if (videoStrm < 0) {
-            if (videoStrm == AVERROR_STREAM_NOT_FOUND)
-                throw QString("Video stream not found");
-            else if (videoStrm == AVERROR_DECODER_NOT_FOUND)
-                throw QString("Decoder not found");
-            else
-                throw QString("Video stream not found: unknown error");
+        src.setThreads(ThreadBudget::shown());
+        src.open(fn, &pool);
+        openCost.openMs = loadClock.nsecsElapsed() / 1e6;
+        openCost.probed = src.probed();
+        fileName = fn;
+        subs.open(src.formatContext());
+
+        // fragmented recordings may still grow and know their length from the fragments only
+        length = src.videoStream()->duration;
+        auto index = std::make_shared<FragmentIndex>();
+        index->update(fn);
+        if (index->isFragmented()) {
+            fragments = index;
+            length = qMax(length, fragments->end(src.videoStream()->id));
+            fileSize = QFileInfo(fn).size();
+            growthWatcher.addPath(fn);
+            growthTimer.start();
         }
+        srcLength = length;
 
-        const AVCodec *subCodec = nullptr;
-        subStrm = av_find_best_stream(ctx, AVMEDIA_TYPE_SUBTITLE, -1, -1, &subCodec, 0);
-        if (subStrm > 0) {
-            subCodecCtx = avcodec_alloc_context3(subCodec);
-            avcodec_parameters_to_context(subCodecCtx, ctx->streams[subStrm]->codecpar);
+        const auto strm = src.videoStream();
+        streamTimeBase = strm->time_base;
+        startPts = strm->start_time != AV_NOPTS_VALUE ? strm->start_time : 0;
 
-            if (avcodec_open2(subCodecCtx, subCodec, nullptr) < 0)
-                qDebug() << QString("cannot open sub codec {0}").arg(subCodec->long_name);
-        }
+        // the mov demuxer takes it from mdhd and mvhd
+        auto entry = av_dict_get(strm->metadata, "creation_time", nullptr, 0);
+        if (!entry)
+            entry = av_dict_get(src.formatContext()->metadata, "creation_time", nullptr, 0);
+        created = entry ? QDateTime::fromString(entry->value, Qt::ISODateWithMs) : QDateTime();
 
         // report number of frames
-        emit streamLength(ctx->streams[videoStrm]->duration);
-
-        // establish codec
-        codecCtx = avcodec_alloc_context3(videoCodec);
-        if (!codecCtx)
-            throw QString("cannot create codec context");
-
-        avcodec_parameters_to_context(codecCtx, ctx->streams[videoStrm]->codecpar);
-
-        if (avcodec_open2(codecCtx, videoCodec, nullptr) < 0)
-            throw QString("cannot open codec {0}").arg(videoCodec->long_name);
+        emit streamLength(length);
 
         frmBuf[0].frm = av_frame_alloc();
         frmBuf[1].frm = av_frame_alloc();
+        curFrm = &frmBuf[0];
+
+        rotation = src.rotation();
 
-        // rotation
-        auto rota = av_dict_get(this->ctx->streams[videoStrm]->metadata, "rotate", nullptr, 0);
-        rotation = rota ? atoi(rota->value) : 0;
+        // decoders for speculative stepping, playback and motion analysis
+        prefetch.open(fn, &pool);
+        player.open(fn, &pool);
+        if (motionScan)
+            scanner.open(fn, &pool);
 
         // success!
         emit loadSuccess();
     }
     catch (QString msg) {
         qCritical() << msg;
+        loadClock.invalidate();
         emit loadError(msg);
         cleanup();
     }
@@ -125,124 +168,585 @@ QString fcs(int fourCC)
 
 void VideoProcessor::present(uint64_t pts)
 {
-    if (!codecCtx) {
+    if (!src.isOpen()) {
         qCritical() << "video not loaded";
         return;
     }
 
-    int rcErr = AVERROR(EAGAIN);
+    // a jump invalidates anything decoded speculatively
+    prefetch.cancel();
+    stepClock.invalidate();
 
-    std::unique_ptr<AVPacket, std::function<void(AVPacket *)>> packet(av_packet_alloc(), [] (AVPacket *p) {
-        av_packet_free(&p);
-    });
+    // past the end the decoder saw when it was opened
+    if (int64_t(pts) >= srcLength)
+        catchUp();
 
-    frmBuf[0].frm->pts = -1;
-    frmBuf[1].frm->pts = -1;
+    beginFrame();
+    counters.add(Metrics::Seeks);
 
-    // seek to keyframe
-    if (av_seek_frame(ctx, videoStrm, pts, AVSEEK_FLAG_BACKWARD) < 0) {
-        qWarning() << "cannot seek to frame" << pts;
-        return;
+    if (seekTo(pts)) {
+        endSeek(false);
+        processCurrentFrame();
+
+        if (isPlaying())
+            startPlayback();
+    }
+    else {
+        frameClock.invalidate();
     }
-    avcodec_flush_buffers(codecCtx);
+}
 
-    // work towards target (intra)frame
-    curFrm = &frmBuf[0];
-    bool found = false;
-    while (av_read_frame(ctx, packet.get()) == 0 && !found) {
-        if (packet->stream_index == videoStrm) {
-            avcodec_send_packet(codecCtx, packet.get());
-
-            while (avcodec_receive_frame(codecCtx, curFrm->frm) == 0 && !found) {
-                const auto curPts = curFrm->frm->pts;
-                if (curPts > pts) {
-                    // overshot, use last frame if available
-                    if (curFrm->other->frm->pts != -1) {
-                        curFrm = curFrm->other;
-                    }
-                    found = true;
-                    break;
-                }
-                else if (curPts == pts) {
-                    // target hit
-                    found = true;
-                    break;
-                }
-                else {
-                    // need to decode more
-                    curFrm = curFrm->other;
-                }
-            }
+int VideoProcessor::presentPrevNext(bool prev)
+{
+    if (!src.isOpen())
+        return 0;
+
+    pause();
+    beginFrame();
+
+    const auto curPts = FrameSource::ptsOf(curFrm->frm);
+    const auto nxt = curFrm->other;
+    const auto prefetched = prefetch.take(curPts, prev, nxt->frm, nxt->sub);
+    bool found;
+
+    counters.add(prefetched ? Metrics::PrefetchHits : Metrics::PrefetchMisses);
+
+    if (prefetched) {
+        // decoded ahead of time, with its subtitle
+        curFrm = nxt;
+        found = true;
+    }
+    else if (prev) {
+        found = seekTo(curPts - 1);
+    }
+    else {
+        // is the own decoder still positioned right after the current frame?
+        if (src.lastPts() != curPts)
+            src.seek(curPts, nxt->frm);
+
+        found = src.next(nxt->frm);
+        if (!found && catchUp()) {
+            src.seek(curPts, nxt->frm);
+            found = src.next(nxt->frm);
         }
-        else if (ctx->streams[packet->stream_index]->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
-            acquireSubtitle(packet.get());
+        if (found) {
+            nxt->sub = subs.text();
+            curFrm = nxt;
         }
     }
 
+    if (found) {
+        endSeek(prefetched);
+        processCurrentFrame();
+        speculate(prev);
+    }
+    else {
+        frameClock.invalidate();
+    }
+
+    return FrameSource::ptsOf(curFrm->frm);
+}
+
+int64_t VideoProcessor::presentSharpest(int radius, const QRectF &shown)
+{
+    if (!src.isOpen() || curFrm->frm->format == -1)
+        return 0;
+
+    const auto roi = frameArea(shown);
+    if (!shown.isNull() && roi.isEmpty())
+        return FrameSource::ptsOf(curFrm->frm);
+
+    pause();
+    prefetch.cancel();
+    stepClock.invalidate();
+
+    const auto curPts = FrameSource::ptsOf(curFrm->frm);
+    const auto span = radius * src.frameDuration();
+    const auto nxt = curFrm->other;
+
+    FramePicker picker([roi](const AVFrame *frm) {
+        return Sharpness::laplacianVariance(frm, roi);
+    });
+
+    // score the window around the current frame while decoding it
+    bool more = src.seek(curPts - span, nxt->frm);
+    while (more && FrameSource::ptsOf(nxt->frm) <= curPts + span) {
+        if (FrameSource::ptsOf(nxt->frm) >= curPts - span)
+            picker.add(nxt->frm, subs.text());
+
+        more = src.next(nxt->frm);
+    }
+
+    if (picker.take(nxt->frm, &nxt->sub)) {
+        curFrm = nxt;
+        processCurrentFrame();
+    }
+
+    return FrameSource::ptsOf(curFrm->frm);
+}
+
+int64_t VideoProcessor::presentStillest(int radius)
+{
+    if (!src.isOpen() || curFrm->frm->format == -1)
+        return AV_NOPTS_VALUE;
+
+    const auto curPts = FrameSource::ptsOf(curFrm->frm);
+    const auto span = radius * src.frameDuration();
+    if (!motionScan)
+        return measureStillest(curPts - span, curPts + span);
+
+    if (!scanner.covers(curPts - span, curPts + span))
+        return AV_NOPTS_VALUE;
+
+    const auto pts = scanner.stillest(curPts - span, curPts + span);
+    if (pts == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+
+    pause();
+    present(pts);
+    return FrameSource::ptsOf(curFrm->frm);
+}
+
+int64_t VideoProcessor::measureStillest(int64_t from, int64_t to)
+{
+    pause();
+    prefetch.cancel();
+    stepClock.invalidate();
+
+    // scored here, the shown decoder exports no vectors so the luma difference stands in
+    FramePicker picker(nullptr);
+    Stillness meter;
+    const auto nxt = curFrm->other;
+
+    bool more = src.seek(from, nxt->frm);
+    while (more && FrameSource::ptsOf(nxt->frm) <= to) {
+        const auto amount = meter.measure(nxt->frm);
+        if (amount >= 0)
+            picker.add(nxt->frm, -amount, subs.text());
+
+        more = src.next(nxt->frm);
+    }
+
+    if (!picker.take(nxt->frm, &nxt->sub))
+        return AV_NOPTS_VALUE;
+
+    curFrm = nxt;
     processCurrentFrame();
+    return FrameSource::ptsOf(curFrm->frm);
 }
 
-int VideoProcessor::presentPrevNext(bool prev)
+void VideoProcessor::beginFrame()
+{
+    frameClock.start();
+    frameCost = Metrics::Frame();
+    srcBefore = src.stats();
+}
+
+void VideoProcessor::endSeek(bool prefetched)
 {
-    if (prev) {
-        present(curFrm->frm->pts - 1);
+    const auto now = src.stats();
+    frameCost.seekMs = frameClock.nsecsElapsed() / 1e6;
+    frameCost.packets = now.packets - srcBefore.packets;
+    frameCost.decoded = now.decoded - srcBefore.decoded;
+    frameCost.bytes = now.bytes - srcBefore.bytes;
+    frameCost.prefetched = prefetched;
+
+    counters.add(Metrics::PacketsRead, frameCost.packets);
+    counters.add(Metrics::FramesDecoded, frameCost.decoded);
+    counters.add(Metrics::BytesRead, frameCost.bytes);
+}
+
+void VideoProcessor::saveStarted()
+{
+    counters.add(Metrics::SavesStarted);
+    counters.add(Metrics::SavesInFlight);
+}
+
+void VideoProcessor::fileGrown()
+{
+    // the watcher reports every write, the index takes complete fragments only
+    const auto size = QFileInfo(fileName).size();
+    if (!fragments || size == fileSize)
+        return;
+
+    fileSize = size;
+    if (!fragments->update(fileName))
+        return;
+
+    // the slider keeps its position
+    const auto end = fragments->end(src.videoStream()->id);
+    if (end > length) {
+        length = end;
+        emit streamLength(length);
     }
-    else {
-        std::unique_ptr<AVPacket, std::function<void(AVPacket *)>> packet(av_packet_alloc(), [] (AVPacket *p) {
-            av_packet_free(&p);
-        });
-
-        curFrm = curFrm->other;
-        bool found = false;
-
-        // is the next frame already available in the decoder?
-        if (avcodec_receive_frame(codecCtx, curFrm->frm) != 0) {
-            // not available, load next packet
-            while (av_read_frame(ctx, packet.get()) == 0) {
-                if (packet->stream_index == videoStrm) {
-                    avcodec_send_packet(codecCtx, packet.get());
-
-                    if (avcodec_receive_frame(codecCtx, curFrm->frm) == 0) {
-                        found = true;
-                        break;
-                    }
-                }
-                else if (packet->stream_index == subStrm) {
-                    acquireSubtitle(packet.get());
-                }
-            }
+}
+
+bool VideoProcessor::catchUp()
+{
+    // libavformat does not read on past the end it once hit, open the grown file again
+    if (length <= srcLength)
+        return false;
+
+    return reopen();
+}
+
+bool VideoProcessor::reopen()
+{
+    try {
+        src.setThreads(ThreadBudget::shown());
+        src.open(fileName, &pool);
+        subs.open(src.formatContext());
+    }
+    catch (QString msg) {
+        qWarning() << "cannot reopen" << fileName << msg;
+        return false;
+    }
+
+    srcLength = length;
+    prefetch.open(fileName, &pool);
+    if (!isPlaying())
+        player.open(fileName, &pool);
+
+    return true;
+}
+
+int64_t VideoProcessor::position() const
+{
+    const auto frm = curFrm->frm;
+    return frm && frm->format != -1 ? FrameSource::ptsOf(frm) : AV_NOPTS_VALUE;
+}
+
+void VideoProcessor::suspend()
+{
+    pause();
+    prefetch.cancel();
+    stepClock.invalidate();
+}
+
+void VideoProcessor::hibernate()
+{
+    if (!src.isOpen())
+        return;
+
+    // the decoders hold the reference frames, the pool what they returned
+    suspend();
+    scanner.suspend();
+    player.close();
+    prefetch.close();
+    src.close();
+    pool.release();
+}
+
+bool VideoProcessor::wake()
+{
+    if (src.isOpen() || fileName.isEmpty())
+        return src.isOpen();
+
+    if (!reopen())
+        return false;
+
+    scanner.resume();
+    return true;
+}
+
+void VideoProcessor::refresh()
+{
+    if (position() == AV_NOPTS_VALUE)
+        return;
+
+    processCurrentFrame();
+    emit positionChanged(position());
+}
+
+void VideoProcessor::unload()
+{
+    cleanup();
+}
+
+bool VideoProcessor::seekTo(int64_t pts)
+{
+    // decode into the spare buffer so the current frame survives a failed seek
+    const auto nxt = curFrm->other;
+    if (!src.seek(pts, nxt->frm))
+        return false;
+
+    nxt->sub = subs.text();
+    curFrm = nxt;
+    return true;
+}
+
+void VideoProcessor::speculate(bool prev)
+{
+    // derive lookahead from direction and rate of consecutive steps
+    int depth = Prefetcher::minDepth;
+    if (stepClock.isValid() && prev == stepPrev) {
+        const auto interval = stepClock.elapsed();
+        if (interval < 500)
+            depth = 1000 / qMax<qint64>(interval, 1);
+    }
+
+    stepClock.start();
+    stepPrev = prev;
+
+    prefetch.speculate(FrameSource::ptsOf(curFrm->frm), prev, depth);
+}
+
+void VideoProcessor::play(int speed)
+{
+    if (!src.isOpen())
+        return;
+
+    if (player.failed()) {
+        qWarning() << "playback unavailable for" << fileName;
+        return;
+    }
+
+    prefetch.cancel();
+    stepClock.invalidate();
+
+    playSpeed = qMax(speed, 1);
+    startPlayback();
+
+    // pace presentation well below the frame interval
+    const auto rate = av_q2d(src.videoStream()->avg_frame_rate);
+    const auto interval = rate > 0 ? 1000.0 / (rate * playSpeed) : 40.0;
+    playTimer.start(qBound(2, int(interval / 4), 20));
+
+    emit playbackChanged(true);
+}
+
+void VideoProcessor::pause()
+{
+    if (!isPlaying())
+        return;
+
+    // curFrm stays on the frame on display
+    playTimer.stop();
+    player.stop();
+
+    emit playbackChanged(false);
+}
+
+void VideoProcessor::startPlayback()
+{
+    player.start(FrameSource::ptsOf(curFrm->frm), playSpeed >= keyframeSpeed);
+    playClock.invalidate();
+}
+
+void VideoProcessor::playbackTick()
+{
+    // clock starts with the first decoded frame so seek latency does not count as lateness
+    if (!playClock.isValid()) {
+        const auto first = player.front();
+        if (first == AV_NOPTS_VALUE) {
+            if (player.atEnd())
+                pause();
+            return;
         }
-        else
-            found = true;
 
-        if (found) {
-           processCurrentFrame();
+        playStart = first;
+        playClock.start();
+    }
+
+    const auto elapsed = av_rescale_q(playClock.nsecsElapsed() / 1000 * playSpeed, AVRational{1, 1000000},
+                                      src.videoStream()->time_base);
+
+    int dropped;
+    const auto nxt = curFrm->other;
+    if (player.take(playStart + elapsed, nxt->frm, nxt->sub, dropped)) {
+        counters.add(Metrics::FramesDropped, dropped);
+
+        curFrm = nxt;
+        processCurrentFrame();
+        emit positionChanged(FrameSource::ptsOf(curFrm->frm));
+    }
+    else if (player.atEnd()) {
+        pause();
+    }
+}
+
+void VideoProcessor::saveFrame(const QRectF &shown)
+{
+    if (!src.isOpen() || curFrm->frm->format == -1)
+        return;
+
+    const auto crop = frameArea(shown);
+    if (!shown.isNull() && crop.isEmpty())
+        return;
+
+    // encode from a reference to the decoded buffers, no copy
+    const auto frm = holdFrame(curFrm->frm);
+
+    const StreamInfo info {fileName, src.videoStream()->id, src.videoStream()->time_base, rotation, fragments};
+    const auto sub = curFrm->sub;
+
+    // drop completed saves
+    saves.remove_if([](const std::future<void> &save) {
+        return save.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+
+#ifdef Q_OS_UNIX
+    if (ring) {
+        saveStarted();
+        saves.push_back(JobScheduler::shared().submit([this, ring = this->ring, frm, info, sub, crop]() {
+            // the selected area only, as for files
+            const auto view = FileWriter::cropped(frm.get(), crop);
+            if (!view) {
+                emit frameSaved(ring->name(), false);
+                return;
+            }
+
+            ExifData exifData;
+            QString iccFileName;
+            ColorParams colorParams;
+            extractMeta(frm.get(), info, exifData, iccFileName, colorParams);
+            addSubtitleMeta(sub, exifData);
+
+            std::vector<uint8_t> exif;
+            ExifSerializer::serialize(exifData, exif);
+            const auto success = ring->publish(view.get(), info.timeBase, colorParams, exif);
+            emit frameSaved(ring->name(), success);
+        }));
+        return;
+    }
+#endif
+
+    const auto loca = reserveFileName();
+    saveStarted();
+    saves.push_back(JobScheduler::shared().submit([this, frm, info, loca, sub, crop]() {
+        const auto success = writeFrame(frm.get(), info, loca, sub, crop);
+        emit frameSaved(loca, success);
+    }));
+}
+
+void VideoProcessor::saveStacked(int radius, bool median)
+{
+    if (!src.isOpen() || curFrm->frm->format == -1)
+        return;
+
+    pause();
+    prefetch.cancel();
+    stepClock.invalidate();
+
+    radius = std::min(radius, (FrameStacker::maxFrames - 1) / 2);
+    const auto curPts = FrameSource::ptsOf(curFrm->frm);
+    const auto span = radius * src.frameDuration();
+    const auto nxt = curFrm->other;
+
+    // references to the window around the current frame
+    std::vector<std::shared_ptr<AVFrame>> window;
+    int ref = -1;
+    bool more = src.seek(curPts - span, nxt->frm);
+    while (more && FrameSource::ptsOf(nxt->frm) <= curPts + span) {
+        const auto pts = FrameSource::ptsOf(nxt->frm);
+        if (pts >= curPts - span) {
+            if (pts == curPts)
+                ref = window.size();
+            window.push_back(holdFrame(nxt->frm));
         }
+
+        more = src.next(nxt->frm);
+    }
+
+    if (ref < 0) {
+        ref = window.size();
+        window.push_back(holdFrame(curFrm->frm));
     }
 
-    return curFrm->frm->pts;
+    const StreamInfo info {fileName, src.videoStream()->id, src.videoStream()->time_base, rotation, fragments};
+    const auto loca = reserveFileName();
+    const auto sub = curFrm->sub;
+    const auto mode = median ? FrameStacker::Mode::Median : FrameStacker::Mode::Mean;
+
+    saves.remove_if([](const std::future<void> &save) {
+        return save.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+
+    saveStarted();
+    saves.push_back(JobScheduler::shared().submit([this, window, ref, mode, info, loca, sub]() {
+        std::vector<const AVFrame *> frames;
+        for (const auto &frm: window)
+            frames.push_back(frm.get());
+
+        auto stacked = FrameStacker::stack(frames, ref, mode);
+        if (!stacked) {
+            qWarning() << "cannot stack this pixel format, saving the single frame";
+            stacked = av_frame_clone(frames[ref]);
+        }
+
+        const auto success = writeFrame(stacked, info, loca, sub);
+        av_frame_free(&stacked);
+        emit frameSaved(loca, success);
+    }));
 }
 
-void VideoProcessor::saveFrame()
+void VideoProcessor::saveBurst(int count)
 {
-    ExifData exifData;
-    QString iccFileName;
-    ColorParams colorParams;
-    auto mdTask = std::async(std::launch::async, [&]() {
-        extractMeta(exifData, iccFileName, colorParams);
+    if (!src.isOpen() || curFrm->frm->format == -1 || count < 1)
+        return;
+
+    pause();
+    prefetch.cancel();
+    stepClock.invalidate();
+
+    const auto curPts = FrameSource::ptsOf(curFrm->frm);
+    const auto nxt = curFrm->other;
+
+    // the current frame and the ones following it, with their subtitles
+    std::vector<std::shared_ptr<AVFrame>> burst {holdFrame(curFrm->frm)};
+    std::vector<QString> texts {curFrm->sub};
+
+    if (src.lastPts() != curPts)
+        src.seek(curPts, nxt->frm);
+    while (int(burst.size()) < count && src.next(nxt->frm)) {
+        burst.push_back(holdFrame(nxt->frm));
+        texts.push_back(subs.text());
+    }
+
+    const StreamInfo info {fileName, src.videoStream()->id, src.videoStream()->time_base, rotation, fragments};
+    const auto loca = reserveFileName();
+
+    saves.remove_if([](const std::future<void> &save) {
+        return save.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
     });
 
+    saveStarted();
+    saves.push_back(JobScheduler::shared().submit([this, burst, texts, info, loca]() {
+        std::vector<AVFrame *> frames;
+        for (const auto &frm: burst)
+            frames.push_back(frm.get());
+
+        const auto success = writeBurst(frames, texts, info, loca);
+        emit frameSaved(loca, success);
+    }));
+}
+
+void VideoProcessor::setRing(std::shared_ptr<RingPublisher> ring)
+{
+    if (ring == this->ring)
+        return;
+
+    // publishing saves still use the ring
+    for (auto &save: saves)
+        save.wait();
+    saves.clear();
+
+    this->ring = std::move(ring);
+}
+
+QString VideoProcessor::reserveFileName()
+{
     // determine file name
     auto loca = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
     loca += "/visie.heic";
 
-    // make file name unique
-    if (QFile::exists(loca)) {
+    // make file name unique, also among saves still in flight
+    if (QFile::exists(loca) || reserved.contains(loca)) {
         loca = loca.replace("/visie.heic", "/visie-%1.heic");
         qulonglong cntr = 0;
         while (true) {
             auto cand = QString(loca).arg(cntr, 3, 10, QChar('0'));
-            if (!QFile::exists(cand)) {
+            if (!QFile::exists(cand) && !reserved.contains(cand)) {
                 loca = cand;
                 break;
             }
@@ -250,39 +754,125 @@ void VideoProcessor::saveFrame()
         }
     }
 
+    reserved.insert(loca);
+    return loca;
+}
+
+QRect VideoProcessor::frameArea(const QRectF &shown) const
+{
+    const auto frm = curFrm->frm;
+    if (shown.isNull() || width <= 0 || height <= 0)
+        return QRect();
+
+    // presented image is the scaled frame turned clockwise by rotation
+    const auto turned = rotation == 90 || rotation == 270;
+    const double shownW = turned ? height : width, shownH = turned ? width : height;
+
+    const auto toFrame = [&](QPointF p) {
+        const auto x = p.x() / shownW, y = p.y() / shownH;
+        switch (rotation) {
+            case 90:
+                return QPointF(y, 1 - x);
+            case 180:
+                return QPointF(1 - x, 1 - y);
+            case 270:
+                return QPointF(1 - y, x);
+            default:
+                return QPointF(x, y);
+        }
+    };
+
+    const auto norm = QRectF(toFrame(shown.topLeft()), toFrame(shown.bottomRight())).normalized();
+    const QRectF area(norm.left() * frm->width, norm.top() * frm->height, norm.width() * frm->width,
+                      norm.height() * frm->height);
+
+    return area.toAlignedRect().intersected(QRect(0, 0, frm->width, frm->height));
+}
+
+bool VideoProcessor::writeFrame(AVFrame *frm, const StreamInfo &info, const QString &fileName, const QString &sub,
+                                const QRect &crop)
+{
+    ExifData exifData;
+    QString iccFileName;
+    ColorParams colorParams;
+    auto mdTask = JobScheduler::shared().offload([&]() {
+        extractMeta(frm, info, exifData, iccFileName, colorParams);
+        addSubtitleMeta(sub, exifData);
+    });
+
+    std::unique_ptr<FileWriter> writer(new HeifWriter);
+    return writer->save(frm, fileName, mdTask, iccFileName, colorParams, exifData, crop);
+}
+
+bool VideoProcessor::writeBurst(const std::vector<AVFrame *> &frames, const std::vector<QString> &texts,
+                                const StreamInfo &info, const QString &fileName)
+{
+    std::vector<ExifData> exifData(frames.size());
+    QString iccFileName;
+    ColorParams colorParams;
+    auto mdTask = JobScheduler::shared().offload([&]() {
+        // the file is parsed for the first frame only, the others take its metadata with their own time and GPS
+        addOrientation(info.rotation, exifData[0]);
+        colorParams = {2, 2, 2}; // undef
+        AVIOContext *pb = nullptr;
+        if (avio_open(&pb, info.fileName.toLocal8Bit(), AVIO_FLAG_READ) >= 0) {
+            MediaReader rd(pb, &exifData[0], info.trackID, frameTime(frames[0], info), info.fragments.get());
+            rd.extract();
+            colorParams = rd.color();
+
+            for (size_t i = 1; i < frames.size(); i++)
+                rd.extractAt(frameTime(frames[i], info), &exifData[i]);
+
+            avio_closep(&pb);
+        }
+        iccFileName = iccFor(colorParams, frames[0]);
+
+        // subtitles last, each frame has its own
+        for (size_t i = 1; i < frames.size(); i++)
+            exifData[i].merge(exifData[0]);
+        for (size_t i = 0; i < frames.size(); i++)
+            addSubtitleMeta(texts[i], exifData[i]);
+    });
+
+    HeifWriter writer;
+    return writer.saveBurst(frames, fileName, mdTask, iccFileName, colorParams, exifData);
+}
+
+void VideoProcessor::addSubtitleMeta(const QString &sub, ExifData &exif)
+{
     // check subs for DJI metadata
     QRegularExpression exp(".+F/([^,]+), SS ([^,]+), ISO ([^,]+), EV ([^,]+), DZOOM ([^,]+), "
                            "GPS \\(([^,]+), ([^,]+), ([^,]+)\\), D ([^,]+), H ([^,]+), H.S ([^,]+), "
                            "V.S ([^,]+) ");
-    auto match = exp.match(subTitle);
-    if (match.hasMatch()) {
-        mdTask.wait();
-
-        MediaReader::gps2Exif(&exifData, match.captured(7), match.captured(6));
-        exifData.add("Exif.Image.ApertureValue", log2f(pow(match.captured(1).toFloat(), 2))); // unit: APEX
-        exifData.add("Exif.Image.ShutterSpeedValue", log2f(1.0 / match.captured(2).toFloat())); // unit: APEX
-        exifData.add("Exif.Photo.ISOSpeed", (uint16_t) match.captured(3).toUInt());
-        exifData.add("Exif.Image.ExposureBiasValue", match.captured(4).toFloat());
-        exifData.add("Exif.Photo.DigitalZoomRatio", match.captured(5).toFloat());
-
-        auto speed = match.captured(12);
-        if (speed.endsWith("m/s")) {
-            exifData.add("Exif.GPSInfo.GPSSpeedRef", "K");
-            exifData.add("Exif.GPSInfo.GPSSpeed", speed.toFloat() * 60.0f / 1000.0f);
-        }
-    }
+    auto match = exp.match(sub);
+    if (!match.hasMatch())
+        return;
 
-    std::unique_ptr<FileWriter> writer(new HeifWriter);
-    writer->save(curFrm->frm, loca, mdTask, iccFileName, colorParams, exifData);
+    MediaReader::gps2Exif(&exif, match.captured(7), match.captured(6));
+    exif.add("Exif.Image.ApertureValue", log2f(pow(match.captured(1).toFloat(), 2))); // unit: APEX
+    exif.add("Exif.Image.ShutterSpeedValue", log2f(1.0 / match.captured(2).toFloat())); // unit: APEX
+    exif.add("Exif.Photo.ISOSpeed", (uint16_t) match.captured(3).toUInt());
+    exif.add("Exif.Image.ExposureBiasValue", match.captured(4).toFloat());
+    exif.add("Exif.Photo.DigitalZoomRatio", match.captured(5).toFloat());
+
+    auto speed = match.captured(12);
+    if (speed.endsWith("m/s")) {
+        exif.add("Exif.GPSInfo.GPSSpeedRef", "K");
+        exif.add("Exif.GPSInfo.GPSSpeed", speed.toFloat() * 60.0f / 1000.0f);
+    }
 }
 
 void VideoProcessor::processCurrentFrame()
 {
     const auto frm = curFrm->frm;
     if (frm->format == -1) {
+        frameClock.invalidate();
         return;
     }
 
+    QElapsedTimer convertClock;
+    convertClock.start();
+
     // create RGB image for presentation
     auto fmt = static_cast<AVPixelFormat>(frm->format);
     if (!cnvCtx) {
@@ -304,33 +894,51 @@ void VideoProcessor::processCurrentFrame()
         width = frm->width / ratio;
         height = frm->height / ratio;
 
+        // native 32 bit pixels are what the view blits without converting
         cnvCtx = sws_getContext(frm->width, frm->height, fmt, width, height,
-                               AV_PIX_FMT_RGB24, SWS_POINT,
+                               AV_PIX_FMT_RGB32, SWS_POINT,
                                nullptr, nullptr, nullptr);
         Q_ASSERT(cnvCtx);
     }
 
-    const uint8_t bytesPerPixel = 24 / 8;
-    const int dstStride[1] = {bytesPerPixel * int(width)};
-    uint8_t *outBuf = new uint8_t[width * height * bytesPerPixel];
+    // reused unless the size changed or someone still holds the image from two frames ago
+    auto &surface = surfaces[nextSurface];
+    nextSurface ^= 1;
+    if (surface.width() != width || surface.height() != height)
+        surface = QImage(width, height, QImage::Format_RGB32);
 
-    auto actualHeight = sws_scale(cnvCtx, frm->data, frm->linesize, 0,
-                                  frm->height, &outBuf, dstStride);
+    uint8_t *outBuf[1] = {surface.bits()};
+    const int dstStride[1] = {int(surface.bytesPerLine())};
+    {
+        Tracer::Span span("sws_scale");
+        sws_scale(cnvCtx, frm->data, frm->linesize, 0, frm->height, outBuf, dstStride);
+    }
 
-    auto qImg = QImage(outBuf, width, actualHeight, *dstStride, QImage::Format_RGB888,
-                         [](void *buf) {
-                            delete [] static_cast<uint8_t *>(buf);
-                         },
-                        outBuf);
+    auto qImg = surface;
 
     // apply rotation
     if (rotation) {
+        Tracer::Span span("rotate");
         QTransform trans;
 
         trans = trans.translate(qImg.width() / 2, qImg.height() / 2).rotate(rotation);
         qImg = qImg.transformed(trans);
     }
 
+    // cost of a seek or step ends with the image handed over
+    counters.add(Metrics::FramesShown);
+    if (frameClock.isValid()) {
+        frameCost.convertMs = convertClock.nsecsElapsed() / 1e6;
+        frameCost.totalMs = frameClock.nsecsElapsed() / 1e6;
+        counters.setLastFrame(frameCost);
+        frameClock.invalidate();
+    }
+    if (loadClock.isValid()) {
+        openCost.firstFrameMs = loadClock.nsecsElapsed() / 1e6;
+        counters.setOpening(openCost);
+        loadClock.invalidate();
+    }
+
     imgReady(qImg);
 
     // --
@@ -338,86 +946,102 @@ void VideoProcessor::processCurrentFrame()
     //--
 }
 
-void VideoProcessor::acquireSubtitle(AVPacket *pkt)
+void VideoProcessor::extractMeta(const AVFrame *frm, const StreamInfo &info, ExifData &exif,
+                                 QString &iccFileName, ColorParams &color, AVIOContext *io)
 {
-    AVSubtitle sub;
-    int gotSub;
-
-    auto len = avcodec_decode_subtitle2(subCodecCtx, &sub, &gotSub, pkt);
-    if (len > 0 && gotSub && sub.num_rects > 0) {
-        subTitle = sub.rects[0]->ass;
-        avsubtitle_free(&sub);
+    addOrientation(info.rotation, exif);
+
+    // BMFF content, read through an own I/O context as decoding goes on meanwhile
+    AVIOContext *pb = io;
+    color = {2, 2, 2}; // undef
+    if (pb || avio_open(&pb, info.fileName.toLocal8Bit(), AVIO_FLAG_READ) >= 0) {
+        MediaReader rd(pb, &exif, info.trackID, frameTime(frm, info), info.fragments.get());
+        rd.extract();
+        color = rd.color();
+
+        if (!io)
+            avio_closep(&pb);
     }
+
+    iccFileName = iccFor(color, frm);
 }
 
-void VideoProcessor::extractMeta(ExifData &exif, QString &iccFileName,
-                                 ColorParams &color)
+double VideoProcessor::frameTime(const AVFrame *frm, const StreamInfo &info)
 {
-    // rotation
-    auto rota = av_dict_get(this->ctx->streams[videoStrm]->metadata, "rotate", nullptr, 0);
-    if (rota) {
-        uint16_t orient = 1;
+    return double(frm->best_effort_timestamp * info.timeBase.num) / info.timeBase.den;
+}
 
-        switch (atoi(rota->value)) {
-            case 90:
-                orient = 6;
-                break;
-            case 180:
-                orient = 3;
-                break;
-            case 270:
-                orient = 8;
-                break;
-            default:
-                orient = 1;
-        }
+void VideoProcessor::addOrientation(int rotation, ExifData &exif)
+{
+    if (!rotation)
+        return;
 
-        exif.add("Exif.Image.Orientation", orient);
+    uint16_t orient = 1;
+
+    switch (rotation) {
+        case 90:
+            orient = 6;
+            break;
+        case 180:
+            orient = 3;
+            break;
+        case 270:
+            orient = 8;
+            break;
+        default:
+            orient = 1;
     }
 
-    // BMFF content
-    auto timeBase = &this->ctx->streams[videoStrm]->time_base;
-    auto timeStamp = double(curFrm->frm->best_effort_timestamp * timeBase->num) / timeBase->den;
-    auto rd = new MediaReader(this->ctx->pb, &exif, this->ctx->streams[videoStrm]->id, timeStamp);
-    rd->extract();
-    color = rd->color();
+    exif.add("Exif.Image.Orientation", orient);
+}
 
+QString VideoProcessor::iccFor(const ColorParams &color, const AVFrame *frm)
+{
     // base color profile selection based on primaries, https://forum.doom9.org/showthread.php?t=168424
     switch (color.primaries)
     {
         case 1:
-            iccFileName = ":/icc/ITU-R_BT709.icc";
-            break;
+            return ":/icc/ITU-R_BT709.icc";
         case 9:
-            iccFileName = ":/icc/ITU-R_BT2020.icc";
-            break;
+            return ":/icc/ITU-R_BT2020.icc";
         default:
             // libavformat may be wrong (OnePlus) but use it as a fallback
-            switch (curFrm->frm->color_trc) {
+            switch (frm->color_trc) {
                 case AVCOL_TRC_BT709:
-                    iccFileName = ":/icc/ITU-R_BT709.icc";
-                    break;
+                    return ":/icc/ITU-R_BT709.icc";
                 case AVCOL_TRC_BT2020_10:
-                    iccFileName = ":/icc/ITU-R_BT2020.icc";
-                    break;
+                    return ":/icc/ITU-R_BT2020.icc";
                 default:
-                    ;
+                    return QString();
             }
     }
-
-    delete rd;
 }
 
 
 void VideoProcessor::cleanup()
 {
-    if (ctx)
-        avformat_free_context(ctx);
-    if (codecCtx)
-        avcodec_free_context(&codecCtx);
-    if (cnvCtx)
+    pause();
+    player.close();
+    prefetch.close();
+    scanner.close();
+    src.close();
+    pool.release();
+
+    growthTimer.stop();
+    if (!growthWatcher.files().isEmpty())
+        growthWatcher.removePaths(growthWatcher.files());
+    fragments.reset();
+    fileSize = length = srcLength = 0;
+    created = QDateTime();
+    fileName.clear();
+
+    subs.close();
+    if (cnvCtx) {
         sws_freeContext(cnvCtx);
+        cnvCtx = nullptr;
+    }
 
     av_frame_free(&frmBuf[0].frm);
     av_frame_free(&frmBuf[1].frm);
+    surfaces[0] = surfaces[1] = QImage();
 }
@@ -2,9 +2,27 @@
 #define VIDEOPROCESSOR_H
 
 #include <QObject>
+#include <QDateTime>
 #include <QImage>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QRect>
+#include <QSet>
+#include <future>
+#include <list>
+#include <memory>
 #include "exiv2wrapper/exiv2wrapper.h"
 #include "colorparams.h"
+#include "framepool.h"
+#include "framesource.h"
+#include "fragmentindex.h"
+#include "metrics.h"
+#include "prefetcher.h"
+#include "player.h"
+#include "ringpublisher.h"
+#include "motionscanner.h"
+#include "subtitlereader.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -16,41 +34,159 @@ class VideoProcessor : public QObject
 {
     Q_OBJECT
 public:
+    // stream properties metadata extraction needs, captured when a save is queued
+    struct StreamInfo {
+        QString fileName;
+        int trackID;
+        AVRational timeBase;
+        int rotation;
+        std::shared_ptr<const FragmentIndex> fragments; // of recordings still growing
+    };
+
     explicit VideoProcessor(QObject *parent = nullptr);
     virtual ~VideoProcessor();
 
     void setDimensions(int width, int height);
     void loadVideo(QString fn);
+    void unload();
+    const QString &file() const {return fileName;};
+    bool isPlaying() const {return playTimer.isActive();};
+    std::vector<MotionScanner::Sample> stillnessCurve() const {return scanner.curve();};
+    const Metrics &metrics() const {return counters;};
+
+    // stream properties kept while the decoders are closed
+    AVRational timeBase() const {return streamTimeBase;};
+    int64_t startTime() const {return startPts;};
+    int64_t duration() const {return length;};
+    // when recording began, from the creation time of the track or else of the file, invalid if unknown
+    QDateTime creationTime() const {return created;};
+    // pts of the frame shown, AV_NOPTS_VALUE if none
+    int64_t position() const;
+
+    // videos in the background: stop what only serves stepping and playback, free the decoders altogether, and
+    // open them again. Index, metadata and the frame shown stay.
+    void suspend();
+    void hibernate();
+    bool wake();
+    // presents the frame shown once more, e.g. after switching videos
+    void refresh();
+
+    static bool writeFrame(AVFrame *frm, const StreamInfo &info, const QString &fileName, const QString &sub,
+                           const QRect &crop = QRect());
+    // frames as items of one file
+    static bool writeBurst(const std::vector<AVFrame *> &frames, const std::vector<QString> &texts,
+                           const StreamInfo &info, const QString &fileName);
+    // container metadata at the frame's time, read through io when given instead of opening the file
+    static void extractMeta(const AVFrame *frm, const StreamInfo &info, ExifData &exif, QString &iccFileName,
+                            ColorParams &color, AVIOContext *io = nullptr);
+    static void addSubtitleMeta(const QString &sub, ExifData &exif);
 
 signals:
     void loadSuccess();
     void loadError(QString msg);
     void streamLength(int64_t count);
     void imgReady(QImage img);
+    void positionChanged(int64_t pts);
+    void playbackChanged(bool playing);
+    void frameSaved(QString fileName, bool success);
 
 public slots:
     void present(uint64_t pts);
     int presentPrevNext(bool prev);
-    void saveFrame();
+    int64_t presentSharpest(int radius, const QRectF &shown = QRectF());
+    int64_t presentStillest(int radius);
+    void saveFrame(const QRectF &shown = QRectF());
+    void saveStacked(int radius, bool median);
+    void saveBurst(int count);
+    // saves publish into ring instead of writing files while set, the ring is shared by all videos
+    void setRing(std::shared_ptr<RingPublisher> ring);
+    void play(int speed);
+    void pause();
 
 protected:
     int width, height, rotation;
-    AVFormatContext* ctx;
-    int videoStrm, subStrm;
-    AVCodecContext *codecCtx, *subCodecCtx;
+    QString fileName;
+    FramePool pool;
+    FrameSource src;
+    SubtitleReader subs;
     SwsContext *cnvCtx;
-    QString subTitle;
 
+    // recordings still being written: fragments appended since opening extend the stream. The decoder ends
+    // where the file ended when it was opened (srcLength), the stream where the index ends (length).
+    std::shared_ptr<FragmentIndex> fragments;
+    QFileSystemWatcher growthWatcher;
+    QTimer growthTimer;
+    int64_t fileSize, length, srcLength;
+    AVRational streamTimeBase;
+    int64_t startPts;
+    QDateTime created;
+
+    // speculative decoding while stepping
+    Prefetcher prefetch;
+    QElapsedTimer stepClock;
+    bool stepPrev;
+
+    // stillness curve of the whole clip, from a decoding pass of its own unless VISIE_MOTION_SCAN is 0
+    MotionScanner scanner;
+    bool motionScan;
+
+    // real-time playback
+    static constexpr int keyframeSpeed = 4;
+    Player player;
+    QTimer playTimer;
+    QElapsedTimer playClock;
+    int64_t playStart;
+    int playSpeed;
+
+    // the subtitle travels with its frame, the reader is ahead of it after reading on
     struct Frame {
         AVFrame *frm;
+        QString sub;
         Frame *other;
     } frmBuf[2];
     Frame *curFrm;
 
+    // presented images are converted into these in turn, the view keeps showing the other one meanwhile
+    QImage surfaces[2];
+    int nextSurface;
+
+    // saves go to local readers through shared memory instead of files
+    std::shared_ptr<RingPublisher> ring;
+
+    // saves in flight
+    std::list<std::future<void>> saves;
+    QSet<QString> reserved;
+
+    // cost of the frame being presented, from the request to the converted image
+    Metrics counters;
+    QElapsedTimer frameClock;
+    Metrics::Frame frameCost;
+    FrameSource::Stats srcBefore;
+    // time to first frame of the video being loaded
+    QElapsedTimer loadClock;
+    Metrics::Opening openCost;
+
     void cleanup();
+    void fileGrown();
+    bool catchUp();
+    bool reopen();
+    bool seekTo(int64_t pts);
+    void beginFrame();
+    void endSeek(bool prefetched);
+    void saveStarted();
+    void speculate(bool prev);
+    // stillest frame of a window, decoded on demand without the motion scan
+    int64_t measureStillest(int64_t from, int64_t to);
+    void startPlayback();
+    void playbackTick();
     void processCurrentFrame();
-    void acquireSubtitle(AVPacket *pkt);
-    void extractMeta(ExifData &exif, QString &iccFileName, ColorParams &color);
+    QString reserveFileName();
+    QRect frameArea(const QRectF &shown) const;
+
+    // parts of extractMeta()
+    static double frameTime(const AVFrame *frm, const StreamInfo &info);
+    static void addOrientation(int rotation, ExifData &exif);
+    static QString iccFor(const ColorParams &color, const AVFrame *frm);
 };
 
 #endif // VIDEOPROCESSOR_H